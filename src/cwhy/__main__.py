@@ -11,7 +11,7 @@ from typing import Any, Optional
 
 from rich.console import Console
 
-from . import cwhy
+from . import batch, browse, cache, cwhy, precommit, report, tidy
 
 
 def py_wrapper(args: argparse.Namespace) -> str:
@@ -91,6 +91,18 @@ def main() -> None:
                 [b]CXX=`cwhy --wrapper \[OPTIONS...] --- c++` make[/b]
             usage (CMake):
                 [b]cmake -DCMAKE_CXX_COMPILER=`cwhy --wrapper \[OPTIONS...] --- c++`[/b]
+            usage (report):
+                [b]cwhy report --html FILE RESULTS...[/b]
+            usage (browse):
+                [b]cwhy browse RESULTS...[/b]
+            usage (batch):
+                [b]cwhy batch \[--output DIRECTORY] RESULTS...[/b]
+            usage (pre-commit hook):
+                [b]cwhy precommit \[--compile-commands FILE][/b]
+            usage (clang-tidy):
+                [b]cwhy tidy \[--apply-fixes] OUTPUT_OR_FIXES_YAML...[/b]
+            usage (cache):
+                [b]cwhy cache export PACK | import PACK... | merge OUTPUT PACK...[/b]
         """
     ).strip()
 
@@ -113,12 +125,40 @@ def main() -> None:
         "subcommand",
         nargs="?",
         default="explain",
-        choices=["explain", "diff-converse"],
+        choices=[
+            "explain",
+            "diff-converse",
+            "report",
+            "browse",
+            "batch",
+            "more",
+            "cache",
+            "precommit",
+            "tidy",
+        ],
         metavar="subcommand",
         help=textwrap.dedent(
             r"""
                 explain:       explain the diagnostic (default)
                 diff-converse: \[experimental] interactively fix errors with CWhy
+                report:        render results collected with --format json
+                browse:        explain failures recorded with --lazy, on demand
+                batch:         explain failures recorded with --lazy with the Batch API
+                more:          the full explanations held back by --two-phase more
+                cache:         export, import or merge packs of cached explanations
+                precommit:     check and explain the translation units of staged changes
+                tidy:          group and explain clang-tidy findings, apply their fixes
+            """
+        ).strip(),
+    )
+    parser.add_argument(
+        "results",
+        nargs="*",
+        help=textwrap.dedent(
+            r"""
+                report, browse, batch: the JSON results files to read
+                cache: the action and pack files
+                tidy: clang-tidy output or --export-fixes YAML files
             """
         ).strip(),
     )
@@ -129,6 +169,26 @@ def main() -> None:
         default="gpt-4o-mini",
         help="the language model to use",
     )
+    parser.add_argument(
+        "--fallback-url",
+        type=str,
+        default=os.environ.get("CWHY_FALLBACK_URL"),
+        help="an OpenAI compatible server to use when the API cannot be reached, "
+        "such as http://localhost:11434/v1 for Ollama",
+    )
+    parser.add_argument(
+        "--fallback-llm",
+        type=str,
+        default="llama3.1",
+        help="the language model to use with --fallback-url",
+    )
+    parser.add_argument(
+        "--fallback-context",
+        type=int,
+        default=4096,
+        help="the context window of --fallback-llm in tokens, which the prompt is "
+        "shrunk to fit",
+    )
     parser.add_argument(
         "--timeout",
         type=int,
@@ -151,6 +211,129 @@ def main() -> None:
         help="the maximum number of code locations tokens to send in the prompt",
     )
 
+    parser.add_argument(
+        "--git-context",
+        action="store_true",
+        help="show what changed since --git-base in the files the error goes through "
+        "first in the code context",
+    )
+    parser.add_argument(
+        "--git-base",
+        type=str,
+        default="HEAD",
+        help="the revision to compare the working tree to for --git-context",
+    )
+
+    parser.add_argument(
+        "--no-resolve-includes",
+        dest="resolve_includes",
+        action="store_false",
+        help="ask the model about missing headers even when a header with a close "
+        "name is in the include path",
+    )
+    parser.add_argument(
+        "--command-context",
+        action="store_true",
+        help="include the command in the prompt, without the include directories, "
+        "defines, warnings and -f flags unrelated to the error",
+    )
+
+    parser.add_argument(
+        "--jobs",
+        type=int,
+        default=8,
+        help="the maximum number of explanations to request concurrently",
+    )
+    parser.add_argument(
+        "--max-clusters",
+        type=int,
+        default=10,
+        help="the maximum number of error clusters to explain, largest first",
+    )
+    parser.add_argument(
+        "--pack-tokens",
+        type=int,
+        default=0,
+        help="bundle small errors into shared requests of up to this many prompt "
+        "tokens (default: 0, disabled)",
+    )
+
+    parser.add_argument(
+        "--structured",
+        action="store_true",
+        help="request explanations as JSON with the root cause, locations, a patch and "
+        "a confidence, validated and rendered to text",
+    )
+    parser.add_argument(
+        "--two-phase",
+        choices=["stream", "more"],
+        default=None,
+        help=textwrap.dedent(
+            r"""
+                first print a one-sentence root cause from --summary-llm, then:
+                stream: the full explanation, requested at the same time
+                more:   nothing, the full explanation is printed by `cwhy more`
+            """
+        ).strip(),
+    )
+    parser.add_argument(
+        "--summary-llm",
+        type=str,
+        default="gpt-4o-mini",
+        help="the fast language model to use for --two-phase summaries",
+    )
+
+    parser.add_argument(
+        "--format",
+        choices=["text", "json", "sarif"],
+        default="text",
+        help=textwrap.dedent(
+            r"""
+                text:  human-readable explanations (default)
+                json:  one JSON object per error cluster and line, appended to --output
+                sarif: a SARIF 2.1.0 log, with a run added to --output per invocation
+            """
+        ).strip(),
+    )
+    parser.add_argument(
+        "--output",
+        type=str,
+        default=None,
+        help=textwrap.dedent(
+            r"""
+                the file to write json or sarif results to (default: standard output),
+                or a directory to write a sarif log per invocation to
+                batch: the directory to write results to (default: cwhy-batch)
+            """
+        ).strip(),
+    )
+    parser.add_argument(
+        "--lazy",
+        action="store_true",
+        help="record failures as json to --output without explaining them, "
+        "see browse",
+    )
+    parser.add_argument(
+        "--html",
+        type=str,
+        default=None,
+        help="report: the HTML file to write",
+    )
+
+    parser.add_argument(
+        "--apply-fixes",
+        action="store_true",
+        help="tidy: apply the fixes from --export-fixes YAML files",
+    )
+    parser.add_argument(
+        "--compile-commands",
+        type=str,
+        default=None,
+        help="precommit: the compilation database to use "
+        "(default: compile_commands.json at the top of the repository or one "
+        "directory below)",
+    )
+
     parser.add_argument(
         "--show-prompt",
         action="store_true",
@@ -164,12 +347,54 @@ def main() -> None:
     parser.add_argument(
         "---",
         dest="command",
-        required=True,
+        default=[],
         help=argparse.SUPPRESS,
         nargs=argparse.REMAINDER,
     )
 
-    args = parser.parse_args()
+    # The command is split off first, argparse would take its own `--`, as in
+    # `dotnet run -- ARGS`, as the end of our options.
+    argv = sys.argv[1:]
+    command = []
+    if "---" in argv:
+        command = argv[argv.index("---") + 1 :]
+        argv = argv[: argv.index("---")]
+    args, unknown = parser.parse_known_args(argv)
+    args.command = command
+
+    if args.subcommand in ["report", "browse", "batch", "cache", "tidy"]:
+        # Positionals following an option are not matched to `results`.
+        args.results.extend(a for a in unknown if not a.startswith("-"))
+        unknown = [a for a in unknown if a.startswith("-")]
+    if unknown:
+        parser.error(f"unrecognized arguments: {' '.join(unknown)}")
+
+    if args.subcommand == "report":
+        if not args.html or not args.results:
+            parser.error("report requires --html FILE and at least one results file")
+        report.main(args)
+        return
+    if args.subcommand == "precommit":
+        precommit.main(args)
+        return
+    if args.subcommand == "cache":
+        cache.main(args)
+        return
+    if args.subcommand == "more":
+        cwhy.more(args)
+        return
+    if args.subcommand in ["browse", "batch", "tidy"]:
+        if not args.results:
+            parser.error(f"{args.subcommand} requires at least one results file")
+        if args.subcommand == "browse":
+            browse.main(args)
+        elif args.subcommand == "tidy":
+            tidy.main(args)
+        else:
+            batch.main(args)
+        return
+    if not args.command:
+        parser.error("the command to run is required after ---")
 
     if not args.wrapper:
         cwhy.main(args)
@@ -0,0 +1,246 @@
+"""
+Explains failures recorded with `--lazy` through the OpenAI Batch API, which is
+cheaper than individual requests in exchange for results within 24 hours.
+
+Each root cause is explained once. Results are written to one JSON lines file per
+recorded command in the output directory, in the same format as `--format json`.
+"""
+
+import argparse
+import hashlib
+import json
+import os
+import re
+import sys
+import tempfile
+import time
+from typing import Any, Dict, Optional, Union
+
+import openai
+
+from . import cache, cwhy, results, structured
+
+_endpoint = "/v1/chat/completions"
+_state_file = "batch.json"
+_final_statuses = ["completed", "failed", "expired", "cancelled"]
+
+# Seconds between status checks, growing up to the maximum.
+_poll_initial = 5.0
+_poll_factor = 1.5
+_poll_maximum = 300.0
+
+
+def _log(message: str) -> None:
+    print(f"[cwhy batch] {message}", file=sys.stderr)
+
+
+def _output_path(directory: str, entry: Dict[str, Any]) -> str:
+    """
+    One file per recorded command, named after its last file argument (usually the
+    source file) and a hash of the command and directory.
+    """
+    command = entry.get("command") or []
+    digest = hashlib.sha256(
+        json.dumps([entry.get("directory"), command]).encode()
+    ).hexdigest()[:8]
+    name = "command"
+    for argument in reversed(command):
+        if "." in argument and not argument.startswith("-"):
+            name = re.sub(r"[^\w.-]", "_", os.path.basename(argument))
+            break
+    return os.path.join(directory, f"{name}-{digest}.jsonl")
+
+
+def _explanation(
+    body: Dict[str, Any], model: str, prompt: str, latency: float
+) -> results.Explanation:
+    usage = body.get("usage") or {}
+    text = body["choices"][0]["message"]["content"]
+    if structured.requested(prompt):
+        try:
+            text = structured.render(structured.parse(text))
+        except ValueError:
+            pass
+    return results.Explanation(
+        text=text,
+        model=body.get("model") or model,
+        prompt_tokens=usage.get("prompt_tokens", 0),
+        completion_tokens=usage.get("completion_tokens", 0),
+        latency=latency,
+    )
+
+
+def collect(
+    args: argparse.Namespace,
+) -> Dict[str, Union[str, results.Explanation]]:
+    """
+    Returns the prompt to send for each pending fingerprint, or its explanation
+    when it is already known.
+    """
+    requests: Dict[str, Union[str, results.Explanation]] = {}
+    for _, entry in results.scan(args.results):
+        key = results.entry_fingerprint(entry)
+        if key in requests and not isinstance(requests[key], str):
+            continue
+        if "explanation" in entry:
+            requests[key] = results.Explanation(
+                text=entry["explanation"],
+                model=entry.get("model", args.llm),
+                prompt_tokens=entry.get("promptTokens", 0),
+                completion_tokens=entry.get("completionTokens", 0),
+                latency=entry.get("latency", 0.0),
+                cached=True,
+            )
+        elif key not in requests:
+            prompt = cwhy.recorded_prompt(args, entry)
+            requests[key] = cache.get(args.llm, prompt) or prompt
+    return requests
+
+
+def submit(
+    client: openai.OpenAI, args: argparse.Namespace, prompts: Dict[str, str]
+) -> str:
+    with tempfile.NamedTemporaryFile(
+        mode="w", suffix=".jsonl", delete=False, encoding="utf-8"
+    ) as f:
+        for key, prompt in prompts.items():
+            request: Dict[str, Any] = {
+                "custom_id": key,
+                "method": "POST",
+                "url": _endpoint,
+                "body": {
+                    "model": args.llm,
+                    "messages": [{"role": "user", "content": prompt}],
+                },
+            }
+            if structured.requested(prompt):
+                request["body"]["response_format"] = structured.RESPONSE_FORMAT
+                request["body"]["max_tokens"] = structured.MAX_TOKENS
+            f.write(json.dumps(request) + "\n")
+    try:
+        with open(f.name, "rb") as input_file:
+            uploaded = client.files.create(file=input_file, purpose="batch")
+    finally:
+        os.remove(f.name)
+    batch = client.batches.create(
+        input_file_id=uploaded.id,
+        endpoint="/v1/chat/completions",
+        completion_window="24h",
+        metadata={"description": "cwhy"},
+    )
+    return batch.id
+
+
+def wait(client: openai.OpenAI, batch_id: str) -> Any:
+    delay = _poll_initial
+    while True:
+        batch = client.batches.retrieve(batch_id)
+        counts = batch.request_counts
+        progress = f" ({counts.completed}/{counts.total})" if counts else ""
+        _log(f"{batch_id}: {batch.status}{progress}")
+        if batch.status in _final_statuses:
+            return batch
+        time.sleep(delay)
+        delay = min(delay * _poll_factor, _poll_maximum)
+
+
+def download(
+    client: openai.OpenAI,
+    args: argparse.Namespace,
+    batch: Any,
+    prompts: Dict[str, str],
+    latency: float,
+) -> Dict[str, Union[results.Explanation, str]]:
+    """
+    Returns the explanation, or the error message, for each fingerprint. Successful
+    explanations are added to the cache.
+    """
+    outcomes: Dict[str, Union[results.Explanation, str]] = {}
+    for file_id in [batch.output_file_id, batch.error_file_id]:
+        if not file_id:
+            continue
+        for line in client.files.content(file_id).text.splitlines():
+            if not line.strip():
+                continue
+            item = json.loads(line)
+            key = item.get("custom_id")
+            if key not in prompts:
+                continue
+            response = item.get("response") or {}
+            if response.get("status_code") == 200:
+                explanation = _explanation(
+                    response["body"], args.llm, prompts[key], latency
+                )
+                cache.put(args.llm, prompts[key], explanation)
+                outcomes[key] = explanation
+            else:
+                error = item.get("error") or response.get("body", {}).get("error")
+                outcomes[key] = json.dumps(error) if error else "request failed"
+    for key in prompts:
+        outcomes.setdefault(key, f"batch {batch.status}")
+    return outcomes
+
+
+def write(
+    args: argparse.Namespace,
+    directory: str,
+    outcomes: Dict[str, Union[results.Explanation, str]],
+) -> int:
+    """
+    Writes one results file per recorded command, returns the number of files.
+    """
+    paths = set()
+    for _, entry in results.scan(args.results):
+        outcome = outcomes.get(results.entry_fingerprint(entry))
+        if outcome is None:
+            continue
+        for field in ["diagnostic", "locations", "sources"]:
+            entry.pop(field, None)
+        if isinstance(outcome, results.Explanation):
+            entry.update(results.explanation_json(outcome))
+        else:
+            entry["error"] = outcome
+        path = _output_path(directory, entry)
+        # Results of an earlier run are replaced.
+        with open(path, "a" if path in paths else "w") as f:
+            f.write(json.dumps(entry) + "\n")
+        paths.add(path)
+    return len(paths)
+
+
+def main(args: argparse.Namespace) -> None:
+    directory = args.output or "cwhy-batch"
+    os.makedirs(directory, exist_ok=True)
+    state_path = os.path.join(directory, _state_file)
+
+    requests = collect(args)
+    prompts = {k: v for k, v in requests.items() if isinstance(v, str)}
+    outcomes: Dict[str, Union[results.Explanation, str]] = {
+        k: v for k, v in requests.items() if isinstance(v, results.Explanation)
+    }
+    _log(f"{len(requests)} root causes, {len(prompts)} to explain")
+
+    if prompts:
+        client = openai.OpenAI()
+        # Resume waiting for a batch submitted by an interrupted run.
+        state: Optional[Dict[str, Any]] = None
+        if os.path.isfile(state_path):
+            with open(state_path, "r") as f:
+                state = json.load(f)
+        if state is None or sorted(state["fingerprints"]) != sorted(prompts):
+            state = {
+                "id": submit(client, args, prompts),
+                "fingerprints": sorted(prompts),
+                "submitted": time.time(),
+            }
+            with open(state_path, "w") as f:
+                json.dump(state, f)
+            _log(f"submitted {state['id']}")
+
+        batch = wait(client, state["id"])
+        latency = time.time() - state["submitted"]
+        outcomes.update(download(client, args, batch, prompts, latency))
+        os.remove(state_path)
+
+    count = write(args, directory, outcomes)
+    _log(f"wrote {count} files to {directory}")
@@ -0,0 +1,198 @@
+"""
+Interactive browser for failures recorded with `--lazy`. Explanations are only
+requested for the failures selected, and for the next few in the background.
+"""
+
+import argparse
+import collections
+import concurrent.futures
+import os
+from typing import Any, Dict, List, Optional
+
+import openai
+from rich.console import Console
+from rich.markdown import Markdown
+from rich.markup import escape
+from rich.table import Table
+
+from . import cwhy, engine, results
+
+# Failures explained ahead of the one being read.
+_prefetch = 3
+
+
+class _Group:
+    """
+    Recorded failures sharing a fingerprint, explained through the first one.
+    """
+
+    def __init__(self, entry: Dict[str, Any]):
+        self.entry = entry
+        self.occurrences = 0
+        self.commands = 0
+
+    def stale_sources(self) -> List[str]:
+        directory = self.entry.get("directory") or os.getcwd()
+        return [
+            file
+            for file, digest in self.entry.get("sources", {}).items()
+            if results.file_digest(os.path.join(directory, file)) != digest
+        ]
+
+
+def load(paths: List[str]) -> List[_Group]:
+    groups: Dict[str, _Group] = collections.OrderedDict()
+    for _, entry in results.scan(paths):
+        key = results.entry_fingerprint(entry)
+        if key not in groups:
+            groups[key] = _Group(entry)
+        group = groups[key]
+        group.occurrences += entry.get("occurrences", 1)
+        group.commands += 1
+        # An explanation recorded eagerly is as good as a cached one.
+        if "explanation" in entry and "explanation" not in group.entry:
+            group.entry = entry
+    return sorted(groups.values(), key=lambda group: -group.occurrences)
+
+
+class Browser:
+    def __init__(self, args: argparse.Namespace, groups: List[_Group]):
+        self.args = args
+        self.groups = groups
+        self.console = Console()
+        self.client = engine.Client(args)
+        self.futures: Dict[int, concurrent.futures.Future] = {}
+
+    def request(self, i: int) -> None:
+        if i in self.futures or not 0 <= i < len(self.groups):
+            return
+        group = self.groups[i]
+        future: concurrent.futures.Future = concurrent.futures.Future()
+        if "explanation" in group.entry:
+            future.set_result(
+                results.Explanation(
+                    text=group.entry["explanation"],
+                    model=group.entry.get("model", ""),
+                    prompt_tokens=group.entry.get("promptTokens", 0),
+                    completion_tokens=group.entry.get("completionTokens", 0),
+                    latency=group.entry.get("latency", 0.0),
+                    cached=True,
+                )
+            )
+        else:
+            # Prompts are built here rather than in the workers, since building
+            # one changes the working directory.
+            prompt = cwhy.recorded_prompt(self.args, group.entry)
+            future = self.client.submit(
+                cwhy.explain_cached(self.client, self.args, prompt)
+            )
+        self.futures[i] = future
+
+    def status(self, i: int) -> str:
+        future = self.futures.get(i)
+        if future is None:
+            return ""
+        if not future.done():
+            return "..."
+        return "error" if future.exception() else "ready"
+
+    def list(self) -> None:
+        table = Table(box=None)
+        table.add_column("#", justify="right")
+        table.add_column("errors", justify="right")
+        table.add_column("commands", justify="right")
+        table.add_column("")
+        table.add_column("first error", no_wrap=True, overflow="ellipsis")
+        for i, group in enumerate(self.groups):
+            table.add_row(
+                str(i + 1),
+                str(group.occurrences),
+                str(group.commands),
+                self.status(i),
+                escape(group.entry.get("key", "")),
+            )
+        self.console.print(table)
+
+    def show(self, i: int) -> None:
+        group = self.groups[i]
+        self.request(i)
+        for j in range(i + 1, i + 1 + _prefetch):
+            self.request(j)
+
+        title = escape(f"[{i + 1}/{len(self.groups)}] {group.entry.get('key')}")
+        self.console.rule(title)
+        self.console.print(
+            f"{group.occurrences} errors in {group.commands} commands, first in "
+            f"`{' '.join(group.entry.get('command', []))}`",
+            markup=False,
+        )
+        stale = group.stale_sources()
+        if stale:
+            self.console.print(
+                f"Changed since the failure was recorded: {', '.join(stale)}",
+                style="yellow",
+                markup=False,
+            )
+
+        with self.console.status("Explaining..."):
+            try:
+                explanation = self.futures[i].result()
+            except openai.OpenAIError as e:
+                self.console.print(str(e).strip(), style="red", markup=False)
+                del self.futures[i]
+                return
+        self.console.print(Markdown(explanation.text))
+        self.console.print(
+            f"[dim]({'cached, ' if explanation.cached else ''}"
+            f"{explanation.latency:.1f} seconds, "
+            f"{explanation.prompt_tokens} prompt tokens, "
+            f"{explanation.completion_tokens} completion tokens.)"
+        )
+
+    def run(self) -> None:
+        self.list()
+        selected: Optional[int] = None
+        while True:
+            try:
+                answer = self.console.input(
+                    "\n[b]#[/b] to explain, [b]Enter[/b] for the next one, "
+                    "[b]l[/b] to list, [b]q[/b] to quit: "
+                ).strip()
+            except (EOFError, KeyboardInterrupt):
+                break
+
+            if answer == "q":
+                break
+            elif answer == "l":
+                self.list()
+                continue
+            elif answer == "":
+                selected = 0 if selected is None else selected + 1
+            elif answer.isdigit() and 1 <= int(answer) <= len(self.groups):
+                selected = int(answer) - 1
+            else:
+                self.console.print(f"Pick a number between 1 and {len(self.groups)}.")
+                continue
+
+            if selected >= len(self.groups):
+                self.console.print("No more failures.")
+                selected = len(self.groups) - 1
+                continue
+            self.show(selected)
+
+    def close(self) -> None:
+        for future in self.futures.values():
+            future.cancel()
+        self.client.close()
+
+
+def main(args: argparse.Namespace) -> None:
+    groups = load(args.results)
+    if not groups:
+        print("No failures recorded.")
+        return
+    browser = Browser(args, groups)
+    try:
+        browser.run()
+    finally:
+        browser.close()
@@ -0,0 +1,178 @@
+"""
+Persistent cache of explanations, one JSON file per explanation, keyed by a hash of
+the model and the prompt. Explanations can also come from packs, see pack.py, that
+are looked up in place after the local files. Paths in the prompt are hashed
+relative to the workspace, so that checkouts at different places share keys.
+"""
+
+import argparse
+import dataclasses
+import functools
+import glob
+import hashlib
+import json
+import os
+import shutil
+import sys
+import tempfile
+from typing import Dict, Iterator, List, Optional, Tuple
+
+from . import pack
+from .results import Explanation
+
+
+def directory() -> str:
+    if "CWHY_CACHE_DIR" in os.environ:
+        return os.environ["CWHY_CACHE_DIR"]
+    base = os.environ.get("XDG_CACHE_HOME") or os.path.join(
+        os.path.expanduser("~"), ".cache"
+    )
+    return os.path.join(base, "cwhy")
+
+
+@functools.lru_cache(maxsize=None)
+def _workspace(cwd: str) -> str:
+    """
+    The root of the checkout containing cwd, or cwd itself outside of one.
+    """
+    path = cwd
+    while not os.path.exists(os.path.join(path, ".git")):
+        parent = os.path.dirname(path)
+        if parent == path:
+            return cwd
+        path = parent
+    return path
+
+
+def key(model: str, prompt: str) -> str:
+    root = _workspace(os.getcwd())
+    if root != os.path.dirname(root):
+        # Build machines and agents check the same code out at different places.
+        prompt = prompt.replace(os.path.join(root, ""), "")
+    return hashlib.sha256(f"{model}\0{prompt}".encode()).hexdigest()
+
+
+def _path(key: str) -> str:
+    return os.path.join(directory(), "explanations", key[:2], f"{key}.json")
+
+
+def _packs_directory() -> str:
+    return os.path.join(directory(), "packs")
+
+
+@functools.lru_cache(maxsize=None)
+def _packs(path: str) -> List[pack.Pack]:
+    """
+    The packs imported in the directory, most recent first.
+    """
+    packs = []
+    files = glob.glob(os.path.join(path, "*.pack"))
+    for file in sorted(files, key=os.path.getmtime, reverse=True):
+        try:
+            packs.append(pack.Pack(file))
+        except (OSError, ValueError):
+            continue
+    return packs
+
+
+def _load(data: bytes) -> Optional[Explanation]:
+    try:
+        fields = json.loads(data)
+        fields["cached"] = True
+        return Explanation(**fields)
+    except (ValueError, TypeError):
+        # Written by an incompatible version.
+        return None
+
+
+def get(model: str, prompt: str) -> Optional[Explanation]:
+    k = key(model, prompt)
+    try:
+        with open(_path(k), "rb") as f:
+            return _load(f.read())
+    except OSError:
+        pass
+    for p in _packs(_packs_directory()):
+        data = p.get(k)
+        if data is not None:
+            return _load(data)
+    return None
+
+
+def put(model: str, prompt: str, explanation: Explanation) -> None:
+    path = _path(key(model, prompt))
+    fields = dataclasses.asdict(explanation)
+    del fields["cached"]
+    try:
+        os.makedirs(os.path.dirname(path), exist_ok=True)
+        # Write then rename, so that concurrent builds never read a partial file.
+        handle, temporary = tempfile.mkstemp(dir=os.path.dirname(path), suffix=".tmp")
+        with os.fdopen(handle, "w") as f:
+            json.dump(fields, f)
+        os.replace(temporary, path)
+    except OSError:
+        # The explanation was paid for, it is shown even if it cannot be kept.
+        pass
+
+
+def _entries() -> Iterator[Tuple[str, bytes]]:
+    """
+    All cached explanations by key, local files first, then imported packs.
+    """
+    pattern = os.path.join(directory(), "explanations", "??", "*.json")
+    for path in glob.glob(pattern):
+        with open(path, "rb") as f:
+            yield os.path.basename(path)[: -len(".json")], f.read()
+    for p in _packs(_packs_directory()):
+        yield from p.items()
+
+
+def _merge(sources: Iterator[Tuple[str, bytes]]) -> Dict[str, bytes]:
+    # The first source of each key wins.
+    entries: Dict[str, bytes] = {}
+    for k, data in sources:
+        entries.setdefault(k, data)
+    return entries
+
+
+def _read_packs(paths: List[str]) -> Iterator[Tuple[str, bytes]]:
+    for path in paths:
+        p = pack.Pack(path)
+        try:
+            yield from p.items()
+        finally:
+            p.close()
+
+
+_usage = """usage:
+    cwhy cache export PACK           write every cached explanation to a pack
+    cwhy cache import PACK...        look explanations up in the packs from now on
+    cwhy cache merge OUTPUT PACK...  combine packs, the first one wins for duplicates"""
+
+
+def main(args: argparse.Namespace) -> None:
+    action, paths = (args.results[0], args.results[1:]) if args.results else ("", [])
+    if action == "export" and len(paths) == 1:
+        entries = _merge(_entries())
+        pack.write(paths[0], entries)
+        print(f"Exported {len(entries)} explanations to {paths[0]}.")
+    elif action == "import" and paths:
+        os.makedirs(_packs_directory(), exist_ok=True)
+        for path in paths:
+            # Check the format before copying.
+            pack.Pack(path).close()
+            with open(path, "rb") as f:
+                digest = hashlib.sha256(f.read()).hexdigest()[:16]
+            target = os.path.join(_packs_directory(), f"{digest}.pack")
+            handle, temporary = tempfile.mkstemp(dir=_packs_directory(), suffix=".tmp")
+            os.close(handle)
+            shutil.copyfile(path, temporary)
+            os.replace(temporary, target)
+            print(f"Imported {path}.")
+    elif action == "merge" and len(paths) >= 2:
+        entries = _merge(_read_packs(paths[1:]))
+        pack.write(paths[0], entries)
+        print(f"Merged {len(entries)} explanations into {paths[0]}.")
+    else:
+        print(_usage, file=sys.stderr)
+        sys.exit(2)
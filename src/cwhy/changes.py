@@ -0,0 +1,107 @@
+"""
+Reads the changes of the working tree with `git diff`. With --git-context, the
+changed hunks of the files an error goes through are shown first in the prompt,
+since new errors usually come from what changed since the last good build.
+"""
+
+import dataclasses
+import functools
+import os
+import re
+import subprocess
+from typing import Dict, List, Optional, Tuple
+
+_hunk_header = re.compile(r"^@@ -\d+(?:,\d+)? \+(\d+)(?:,(\d+))? @@")
+
+
+@dataclasses.dataclass
+class Hunk:
+    # The lines of the new version, last is first - 1 for removals only.
+    first: int
+    last: int
+    # The hunk in unified format, with its header.
+    text: str
+
+
+def _git(*arguments: str) -> Optional[str]:
+    process = subprocess.run(
+        ["git", *arguments],
+        stdout=subprocess.PIPE,
+        stderr=subprocess.DEVNULL,
+        text=True,
+    )
+    return process.stdout if process.returncode == 0 else None
+
+
+def toplevel() -> Optional[str]:
+    output = _git("rev-parse", "--show-toplevel")
+    return output.strip() if output else None
+
+
+def diff(arguments: List[str]) -> Dict[str, List[Hunk]]:
+    """
+    The hunks of `git diff` with the arguments given, by absolute path. Empty when
+    not in a repository or when git fails, for example with an unknown revision.
+    """
+    root = toplevel()
+    output = _git("diff", "--no-color", "--no-ext-diff", *arguments)
+    if root is None or output is None:
+        return {}
+    hunks: Dict[str, List[Hunk]] = {}
+    path: Optional[str] = None
+    header = False
+    for line in output.splitlines():
+        if line.startswith("diff "):
+            path, header = None, True
+        elif header and line.startswith("+++ "):
+            name = line[4:]
+            # Deleted files are compared to /dev/null.
+            path = os.path.join(root, name[2:]) if name.startswith("b/") else None
+            if path:
+                hunks.setdefault(path, [])
+        elif header and not line.startswith("@@"):
+            continue
+        else:
+            match = _hunk_header.match(line)
+            if match:
+                header = False
+                if path:
+                    first = int(match.group(1))
+                    count = int(match.group(2) or 1)
+                    hunks[path].append(Hunk(first, first + count - 1, line))
+            elif path and hunks[path]:
+                hunks[path][-1].text += "\n" + line
+    return hunks
+
+
+@functools.lru_cache(maxsize=None)
+def since(base: str, root: Optional[str]) -> Dict[str, List[Hunk]]:
+    """
+    The changes of the working tree since the base revision, by real path. Cached
+    for the repository, since every prompt of a run asks for them.
+    """
+    return {
+        os.path.realpath(path): hunks
+        for path, hunks in diff(["--unified=3", base, "--"]).items()
+    }
+
+
+def _distance(hunk: Hunk, line: int) -> int:
+    if hunk.first <= line <= hunk.last:
+        return 0
+    return min(abs(line - hunk.first), abs(line - hunk.last))
+
+
+def ranked(base: str, files: Dict[str, List[int]]) -> List[Tuple[str, Hunk]]:
+    """
+    The hunks changed in the given files, with the lines an error points to in each,
+    closest to an error line first. Files only reached through includes come last.
+    """
+    changes = since(base, toplevel())
+    result = []
+    for name, lines in files.items():
+        for hunk in changes.get(os.path.realpath(name), []):
+            distances = [_distance(hunk, line) for line in lines]
+            result.append((min(distances, default=float("inf")), name, hunk))
+    result.sort(key=lambda item: item[0])
+    return [(name, hunk) for _, name, hunk in result]
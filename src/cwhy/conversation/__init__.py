@@ -1,14 +1,18 @@
+import asyncio
 import json
 import textwrap
 
-import openai
-
+from .. import engine
 from . import utils
 from .diff_functions import DiffFunctions
 
 
-def diff_converse(client: openai.OpenAI, args, diagnostic):
-    fns = DiffFunctions(args)
+async def diff_converse(client: engine.Client, args, diagnostic) -> str:
+    """
+    Converses until the command succeeds. Tools run on the executor, they must not
+    exit the process, which would leave the event loop stuck.
+    """
+    fns = DiffFunctions(args, diagnostic)
     tools = fns.as_tools()
     tool_names = [fn["function"]["name"] for fn in tools]
     system_message = textwrap.dedent(
@@ -26,30 +30,33 @@ def diff_converse(client: openai.OpenAI, args, diagnostic):
 
     while True:
         # 1. Pick an action.
-        completion = client.chat.completions.create(  # type: ignore
-            model=args.llm,
-            messages=conversation,
-            tools=[
-                {
-                    "type": "function",
-                    "function": {
-                        "name": "pick_action",
-                        "description": "Picks an action to get more information about the code or fix it.",
-                        "parameters": {
-                            "type": "object",
-                            "properties": {
-                                "action": {
-                                    "type": "string",
-                                    "enum": tool_names,
+        completion = await client.create(
+            dict(
+                model=args.llm,
+                messages=conversation,
+                tools=[
+                    {
+                        "type": "function",
+                        "function": {
+                            "name": "pick_action",
+                            "description": "Picks an action to get more information about the code or fix it.",
+                            "parameters": {
+                                "type": "object",
+                                "properties": {
+                                    "action": {
+                                        "type": "string",
+                                        "enum": tool_names,
+                                    },
                                 },
+                                "required": ["action"],
                             },
-                            "required": ["action"],
                         },
-                    },
-                }
-            ],
-            tool_choice={"type": "function", "function": {"name": "pick_action"}},
-            timeout=args.timeout,
+                    }
+                ],
+                tool_choice={"type": "function", "function": {"name": "pick_action"}},
+                timeout=args.timeout,
+            ),
+            args.timeout,
         )
 
         assert completion.choices and len(completion.choices) == 1
@@ -60,22 +67,30 @@ def diff_converse(client: openai.OpenAI, args, diagnostic):
         action = arguments["action"]
 
         tool = [t for t in tools if t["function"]["name"] == action][0]
-        completion = client.chat.completions.create(  # type: ignore
-            model=args.llm,
-            messages=conversation,
-            tools=[tool],
-            tool_choice={
-                "type": "function",
-                "function": {"name": tool["function"]["name"]},
-            },
-            timeout=args.timeout,
+        completion = await client.create(
+            dict(
+                model=args.llm,
+                messages=conversation,
+                tools=[tool],
+                tool_choice={
+                    "type": "function",
+                    "function": {"name": tool["function"]["name"]},
+                },
+                timeout=args.timeout,
+            ),
+            args.timeout,
         )
 
         assert completion.choices and len(completion.choices) == 1
         choice = completion.choices[0]
         assert choice.message.tool_calls and len(choice.message.tool_calls) == 1
         tool_call = choice.message.tool_calls[0]
-        function_response = fns.dispatch(tool_call.function)
+        # Tools may compile the code, which should not block the event loop.
+        function_response = await asyncio.get_running_loop().run_in_executor(
+            None, fns.dispatch, tool_call.function
+        )
+        if fns.compiled:
+            return "Compilation successful!"
         if function_response:
             conversation.append(choice.message)
             conversation.append(
@@ -2,18 +2,20 @@ import argparse
 import difflib
 import json
 import subprocess
-import sys
 import traceback
 from typing import Optional
 
+from .. import frontends, preprocess
 from . import utils
 from .explain_functions import ExplainFunctions
 
 
 class DiffFunctions:
-    def __init__(self, args: argparse.Namespace):
+    def __init__(self, args: argparse.Namespace, diagnostic: str = ""):
         self.args = args
-        self.explain_functions = ExplainFunctions(args)
+        self.explain_functions = ExplainFunctions(args, diagnostic)
+        # Set by try_compiling once the command succeeds, which ends the conversation.
+        self.compiled = False
 
     def as_tools(self):
         return self.explain_functions.as_tools() + [
@@ -132,7 +134,15 @@ class DiffFunctions:
         )
 
         if process.returncode == 0:
-            print("Compilation successful!")
-            sys.exit(0)
+            self.compiled = True
+            return None
 
-        return utils.get_truncated_error_message(self.args, process.stderr)
+        stdout = preprocess.strip_ansi(process.stdout)
+        stderr = preprocess.strip_ansi(process.stderr)
+        diagnostic = stderr if stderr else stdout
+        frontend = frontends.detect(self.args)
+        if frontend:
+            clusters = frontend.clusters(stdout, stderr)
+            if clusters:
+                diagnostic = frontends.summarize(clusters[: self.args.max_clusters])
+        return utils.get_truncated_error_message(self.args, diagnostic)
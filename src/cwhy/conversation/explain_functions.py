@@ -5,10 +5,13 @@ from typing import Optional
 
 import llm_utils
 
+from .. import flags
+
 
 class ExplainFunctions:
-    def __init__(self, args: argparse.Namespace):
+    def __init__(self, args: argparse.Namespace, diagnostic: str = ""):
         self.args = args
+        self.diagnostic = diagnostic
 
     def as_tools(self):
         return [
@@ -42,10 +45,10 @@ class ExplainFunctions:
         """
         {
             "name": "get_compile_or_run_command",
-            "description": "Returns the command used to compile or run the code. This will include any flags and options used."
+            "description": "Returns the command used to compile or run the code, with the flags and options relevant to the error. Other include directories, defines, warnings and -f flags are only counted."
         }
         """
-        result = " ".join(self.args.command)
+        result = flags.summarize(self.args.command, self.diagnostic)
         print(result)
         return result
 
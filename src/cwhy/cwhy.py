@@ -1,24 +1,58 @@
 import argparse
+import concurrent.futures
+import glob
+import hashlib
+import json
+import os
 import subprocess
 import sys
+import tempfile
 import time
+from typing import Any, Callable, Dict, Iterator, List, Optional, Tuple, Union
 
-import llm_utils
 import openai
 
-from . import conversation, prompts
+from . import (
+    cache,
+    conversation,
+    endpoints,
+    engine,
+    frontends,
+    includes,
+    packing,
+    preprocess,
+    prompts,
+    results,
+    structured,
+)
 
+# Enough for one sentence, so that the summary arrives within about a second.
+_summary_max_tokens = 80
+# Seconds after which runs left for `cwhy more` are forgotten.
+_pending_ttl = 7 * 24 * 3600
 
-def complete(client: openai.OpenAI, args: argparse.Namespace, user_prompt: str):
+
+async def complete(
+    client: engine.Client,
+    args: argparse.Namespace,
+    user_prompt: str,
+    **options: Any,
+):
+    """
+    Options, such as model, max_tokens or response_format, override the defaults.
+    """
+    request: Dict[str, Any] = {
+        "model": args.llm,
+        "messages": [{"role": "user", "content": user_prompt}],
+        "timeout": args.timeout,
+    }
+    request.update(options)
     try:
-        completion = client.chat.completions.create(
-            model=args.llm,
-            messages=[{"role": "user", "content": user_prompt}],
-            timeout=args.timeout,
-        )
-        return completion
+        return await client.create(request, args.timeout)
     except openai.NotFoundError as e:
-        print(f"'{args.llm}' either does not exist or you do not have access to it.")
+        print(
+            f"'{request['model']}' either does not exist or you do not have access to it."
+        )
         raise e
     except openai.BadRequestError as e:
         print("Something is wrong with your prompt.")
@@ -26,22 +60,332 @@ def complete(client: openai.OpenAI, args: argparse.Namespace, user_prompt: str):
     except openai.RateLimitError as e:
         print("You have exceeded a rate limit or have no remaining funds.")
         raise e
-    except openai.APITimeoutError as e:
+    except (openai.APITimeoutError, engine.DeadlineExceeded) as e:
         print("The API timed out.")
         print("You can increase the timeout with the --timeout option.")
         raise e
 
 
-def evaluate(client: openai.OpenAI, args: argparse.Namespace, stdin: str) -> str:
+def evaluate(
+    client: engine.Client,
+    args: argparse.Namespace,
+    stdin: str,
+    clusters: Optional[List[frontends.ErrorCluster]] = None,
+) -> str:
     if args.subcommand == "explain":
+        if clusters:
+            return evaluate_clusters(client, args, clusters)
         return evaluate_text_prompt(client, args, prompts.explain_prompt(args, stdin))
     elif args.subcommand == "diff-converse":
-        return conversation.diff_converse(client, args, stdin)
+        if clusters:
+            stdin = frontends.summarize(clusters[: args.max_clusters])
+        # As many requests as it takes, each with its own deadline.
+        return client.run(conversation.diff_converse(client, args, stdin))
     else:
         raise Exception(f"unknown subcommand: {args.subcommand}")
 
 
+def cluster_prompts(
+    args: argparse.Namespace, clusters: List[frontends.ErrorCluster]
+) -> List[str]:
+    return [
+        prompts.explain_prompt(args, cluster.diagnostic(), cluster.locations())
+        for cluster in clusters[: args.max_clusters]
+    ]
+
+
+def explain_concurrently(
+    client: engine.Client, args: argparse.Namespace, requests: List[str]
+) -> Iterator[Tuple[int, Union[results.Explanation, openai.OpenAIError]]]:
+    """
+    Sends up to --jobs requests at the same time, yielding (index, result) pairs in
+    completion order. With --pack-tokens, small prompts share requests.
+    """
+    if args.pack_tokens:
+        groups = packing.bundles(args, requests)
+    else:
+        groups = [[i] for i in range(len(requests))]
+
+    futures: Dict[concurrent.futures.Future, List[int]] = {}
+    for group in groups:
+        future: concurrent.futures.Future
+        if len(group) == 1:
+            future = client.submit(explain(client, args, requests[group[0]]))
+        else:
+            bundle = [requests[i] for i in group]
+            future = client.submit(explain_bundle(client, args, bundle))
+        futures[future] = group
+    try:
+        for future in concurrent.futures.as_completed(futures):
+            group = futures[future]
+            try:
+                result: Any = future.result()
+            except openai.OpenAIError as e:
+                # No other request connects either, the caller falls back.
+                if endpoints.unreachable(e):
+                    raise
+                for i in group:
+                    yield i, e
+                continue
+            if len(group) == 1:
+                yield group[0], result
+            else:
+                yield from zip(group, result)
+    finally:
+        # When the caller stops early, for example after an error.
+        for future in futures:
+            future.cancel()
+
+
+def cluster_title(cluster: frontends.ErrorCluster, i: int, n: int) -> str:
+    return f"[{i + 1}/{n}] {cluster.key} ({len(cluster.records)} occurrences)"
+
+
+def evaluate_clusters(
+    client: engine.Client,
+    args: argparse.Namespace,
+    clusters: List[frontends.ErrorCluster],
+) -> str:
+    """
+    Explain each cluster once, sending up to --jobs requests at the same time.
+    """
+    explanations = dict(
+        explain_concurrently(client, args, cluster_prompts(args, clusters))
+    )
+
+    sections = []
+    for i, result in sorted(explanations.items()):
+        text = result.format() if isinstance(result, results.Explanation) else result
+        title = cluster_title(clusters[i], i, len(explanations))
+        sections.append(f"{title}\n\n{str(text).strip()}")
+    if len(clusters) > len(explanations):
+        sections.append(
+            f"({len(clusters) - len(explanations)} more error clusters not explained, "
+            "see --max-clusters.)"
+        )
+    return "\n\n".join(sections)
+
+
+def _pending_directory() -> str:
+    return os.path.join(cache.directory(), "more")
+
+
+def _pending_path(directory: str, command: List[str]) -> str:
+    """
+    One file per command and directory, so that concurrent runs, for example of a
+    parallel build, do not overwrite each other.
+    """
+    digest = hashlib.sha256(json.dumps([directory, command]).encode()).hexdigest()
+    return os.path.join(_pending_directory(), f"{digest[:16]}.json")
+
+
+def _save_pending(
+    args: argparse.Namespace, titles: List[str], requests: List[str]
+) -> None:
+    directory = _pending_directory()
+    pending = {
+        "directory": os.getcwd(),
+        "command": args.command,
+        "model": args.llm,
+        "titles": titles,
+        "prompts": requests,
+    }
+    try:
+        os.makedirs(directory, exist_ok=True)
+        for path in glob.glob(os.path.join(directory, "*.json")):
+            if time.time() - os.path.getmtime(path) > _pending_ttl:
+                os.remove(path)
+        # Write then rename, so that `cwhy more` never reads a partial file.
+        handle, temporary = tempfile.mkstemp(dir=directory, suffix=".tmp")
+        with os.fdopen(handle, "w") as f:
+            json.dump(pending, f)
+        os.replace(temporary, _pending_path(os.getcwd(), args.command))
+    except OSError:
+        pass
+
+
+def _load_pending() -> Optional[Dict[str, Any]]:
+    """
+    The last run in this directory, or in any directory if there is none.
+    """
+    runs = []
+    for path in glob.glob(os.path.join(_pending_directory(), "*.json")):
+        try:
+            with open(path, "r") as f:
+                runs.append((os.path.getmtime(path), json.load(f)))
+        except (OSError, ValueError):
+            continue
+    runs.sort(key=lambda run: run[0], reverse=True)
+    here = [run for _, run in runs if run.get("directory") == os.getcwd()]
+    if here:
+        return here[0]
+    return runs[0][1] if runs else None
+
+
+def explain_two_phase(
+    client: engine.Client,
+    args: argparse.Namespace,
+    diagnostic: str,
+    clusters: List[frontends.ErrorCluster],
+) -> None:
+    """
+    Print a one-sentence root cause for each error from --summary-llm as soon as it
+    arrives, then the full explanations, which are requested in the background at
+    the same time. With `--two-phase more`, the full explanations are left for
+    `cwhy more` instead.
+    """
+    if clusters:
+        clusters = clusters[: args.max_clusters]
+        titles = [cluster_title(c, i, len(clusters)) for i, c in enumerate(clusters)]
+        requests = cluster_prompts(args, clusters)
+    else:
+        titles = [""]
+        requests = [prompts.explain_prompt(args, diagnostic)]
+
+    # Saved for `cwhy more`.
+    _save_pending(args, titles, requests)
+
+    summaries = [
+        client.submit(
+            explain(
+                client,
+                args,
+                prompts.summary_prompt(prompt),
+                model=args.summary_llm,
+                max_tokens=_summary_max_tokens,
+            )
+        )
+        for prompt in requests
+    ]
+    details = []
+    if args.two_phase == "stream":
+        details = [
+            client.submit(explain_cached(client, args, prompt)) for prompt in requests
+        ]
+
+    for title, future in zip(titles, summaries):
+        try:
+            summary = future.result()
+            text = f"{summary.text.strip()} ({summary.latency:.1f} seconds)"
+        except openai.OpenAIError as e:
+            if endpoints.unreachable(e):
+                raise
+            text = str(e).strip()
+        print(f"{title}\n{text}\n" if title else f"{text}\n", flush=True)
+
+    if args.two_phase == "more":
+        print("Run `cwhy more` for the full explanation.")
+        return
+    for title, future in zip(titles, details):
+        print("==================================================")
+        try:
+            print(f"{title}\n\n" if title else "", end="")
+            print(future.result().format(), flush=True)
+        except openai.OpenAIError as e:
+            if endpoints.unreachable(e):
+                raise
+            print(str(e).strip(), flush=True)
+
+
+def more(args: argparse.Namespace) -> None:
+    """
+    Print the full explanations of the last `--two-phase` run in the current
+    directory, from the cache when they were already requested.
+    """
+    pending = _load_pending()
+    if pending is None:
+        print("Nothing to explain, run with --two-phase first.")
+        return
+    args.llm = pending["model"]
+    with engine.Client(args) as client:
+        futures = [
+            client.submit(explain_cached(client, args, prompt))
+            for prompt in pending["prompts"]
+        ]
+        sections = []
+        for title, future in zip(pending["titles"], futures):
+            try:
+                text = future.result().format()
+            except openai.OpenAIError as e:
+                text = str(e).strip()
+            sections.append(f"{title}\n\n{text}" if title else text)
+    print("\n\n".join(sections))
+
+
+def write_results(
+    client: engine.Client,
+    args: argparse.Namespace,
+    diagnostic: str,
+    clusters: List[frontends.ErrorCluster],
+) -> None:
+    """
+    Explain and stream results in the --format requested, as they complete.
+    """
+    if clusters:
+        clusters = clusters[: args.max_clusters]
+        requests = cluster_prompts(args, clusters)
+    else:
+        clusters = [frontends.from_diagnostic(diagnostic)]
+        requests = [prompts.explain_prompt(args, diagnostic)]
+    with results.open_writer(args) as writer:
+        for i, result in explain_concurrently(client, args, requests):
+            writer.write(clusters[i], result)
+
+
+def record_failures(
+    args: argparse.Namespace,
+    diagnostic: str,
+    clusters: List[frontends.ErrorCluster],
+) -> None:
+    """
+    Write every cluster without explaining it, for `cwhy browse`.
+    """
+    with results.open_writer(args) as writer:
+        if not clusters:
+            writer.record(frontends.from_diagnostic(diagnostic), diagnostic, None)
+        for cluster in clusters:
+            writer.record(cluster, cluster.diagnostic(), cluster.locations())
+
+
+def recorded_prompt(args: argparse.Namespace, entry: Dict[str, Any]) -> str:
+    """
+    Builds the prompt for a failure recorded with --lazy.
+    """
+    diagnostic = entry.get("diagnostic")
+    if diagnostic is None:
+        # Recorded eagerly, and the explanation failed.
+        records = entry.get("records", [])
+        diagnostic = "\n".join(r.get("message", "") for r in records)
+    locations: Optional[List[Tuple[str, int]]] = None
+    if "locations" in entry:
+        locations = [(file, line) for file, line in entry["locations"]]
+
+    # The recorded command, rather than this one.
+    args = argparse.Namespace(**{**vars(args), "command": entry.get("command") or []})
+
+    # Source paths are relative to where the command was run. This is not thread
+    # safe, prompts should be built from a single thread.
+    cwd = os.getcwd()
+    try:
+        os.chdir(entry.get("directory") or cwd)
+        return prompts.explain_prompt(args, diagnostic, locations)
+    finally:
+        os.chdir(cwd)
+
+
 def main(args: argparse.Namespace) -> None:
+    frontend = frontends.detect(args)
+    if frontend:
+        args.command = frontend.prepare(args.command)
+    try:
+        run(args, frontend)
+    finally:
+        # After diff-converse too, which runs the prepared command again.
+        if frontend:
+            frontend.cleanup()
+
+
+def run(args: argparse.Namespace, frontend: Optional[frontends.FrontEnd]) -> None:
     process = subprocess.run(
         args.command,
         stdout=subprocess.PIPE,
@@ -49,50 +393,221 @@ def main(args: argparse.Namespace) -> None:
         text=True,
     )
 
-    if process.returncode == 0:
+    # The output is shown as it was, but parsed without colors.
+    stdout = preprocess.strip_ansi(process.stdout)
+    stderr = preprocess.strip_ansi(process.stderr)
+
+    returncode = process.returncode
+    if frontend:
+        returncode = frontend.returncode(returncode, stdout, stderr)
+    if returncode == 0 and not (frontend and frontend.has_findings(stdout, stderr)):
         return
 
+    clusters = frontend.clusters(stdout, stderr) if frontend else []
+    (shown_stdout, shown_stderr) = (process.stdout, process.stderr)
+    if frontend:
+        (shown_stdout, shown_stderr) = frontend.display(shown_stdout, shown_stderr)
+
     if args.show_prompt:
         print("===================== Prompt =====================")
         if args.subcommand == "explain":
-            print(prompts.explain_prompt(args, process.stderr))
+            if clusters:
+                print("\n\n".join(cluster_prompts(args, clusters)))
+            else:
+                print(prompts.explain_prompt(args, stderr))
         print("==================================================")
         sys.exit(0)
 
-    print(process.stdout)
-    print(process.stderr, file=sys.stderr)
+    diagnostic = stderr if stderr else stdout
+
+    if args.lazy:
+        print(shown_stdout)
+        print(shown_stderr, file=sys.stderr)
+        record_failures(args, diagnostic, clusters)
+        sys.exit(returncode)
+
+    # Missing headers with a close match are answered without a request.
+    local = None
+    if args.subcommand == "explain" and args.resolve_includes and not clusters:
+        local = includes.explain(args, diagnostic)
+    endpoint = None
+    if local is None:
+        endpoint = endpoints.select(args)
+        if endpoint is None:
+            local = endpoints.offline(diagnostic, clusters)
+
+    if args.format != "text" and args.subcommand == "explain":
+        # Keep standard output for the results.
+        print(shown_stdout, file=sys.stderr)
+        print(shown_stderr, file=sys.stderr)
+        try:
+            if endpoint and not explain_with_fallback(
+                args,
+                endpoint,
+                lambda client: write_results(client, args, diagnostic, clusters),
+            ):
+                local = endpoints.offline(diagnostic, clusters)
+            if local:
+                with results.open_writer(args) as writer:
+                    writer.write(frontends.from_diagnostic(diagnostic), local)
+        except openai.OpenAIError as e:
+            print(str(e).strip(), file=sys.stderr)
+        sys.exit(returncode)
+
+    print(shown_stdout)
+    print(shown_stderr, file=sys.stderr)
     print("==================================================")
     print("CWhy")
     print("==================================================")
 
+    def explain_text(client: engine.Client) -> None:
+        if args.two_phase and args.subcommand == "explain":
+            explain_two_phase(client, args, diagnostic, clusters)
+        else:
+            print(evaluate(client, args, diagnostic, clusters))
+
     try:
-        client = openai.OpenAI()
-        result = evaluate(
-            client, args, process.stderr if process.stderr else process.stdout
-        )
-        print(result)
+        if endpoint:
+            if not explain_with_fallback(args, endpoint, explain_text):
+                local = endpoints.offline(diagnostic, clusters)
+            elif args.subcommand == "diff-converse":
+                # It only returns once the command succeeds.
+                returncode = 0
+        if local:
+            print(local.format())
     except openai.OpenAIError as e:
         print(str(e).strip())
     print("==================================================")
 
-    sys.exit(process.returncode)
+    sys.exit(returncode)
 
 
-def evaluate_text_prompt(
-    client: openai.OpenAI, args: argparse.Namespace, prompt: str, wrap: bool = True
-) -> str:
+def explain_with_fallback(
+    args: argparse.Namespace,
+    endpoint: endpoints.Endpoint,
+    use: Callable[[engine.Client], None],
+) -> bool:
+    """
+    Explains with a client for the endpoint, then for the next endpoints of the
+    chain while requests cannot connect. False when none could be reached.
+    """
+    current: Optional[endpoints.Endpoint] = endpoint
+    while current:
+        try:
+            with engine.Client(args, current) as client:
+                use(client)
+            return True
+        except openai.APIConnectionError as e:
+            if not endpoints.unreachable(e):
+                raise
+            print(str(e).strip(), file=sys.stderr)
+            current = endpoints.failed(args, current)
+    return False
+
+
+async def explain(
+    client: engine.Client, args: argparse.Namespace, prompt: str, **options: Any
+) -> results.Explanation:
+    if structured.requested(prompt) and not options:
+        try:
+            return await explain_structured(client, args, prompt)
+        except ValueError:
+            # Cut off or malformed, the question also works for a free-form answer.
+            pass
+    start = time.time()
+    completion = await complete(client, args, prompt, **options)
+    end = time.time()
+
+    return results.Explanation(
+        text=completion.choices[0].message.content,
+        model=completion.model or options.get("model", args.llm),
+        prompt_tokens=completion.usage.prompt_tokens,
+        completion_tokens=completion.usage.completion_tokens,
+        latency=end - start,
+    )
+
+
+async def explain_structured(
+    client: engine.Client, args: argparse.Namespace, prompt: str
+) -> results.Explanation:
     start = time.time()
-    completion = complete(client, args, prompt)
+    completion = await complete(
+        client,
+        args,
+        prompt,
+        response_format=structured.RESPONSE_FORMAT,
+        max_tokens=structured.MAX_TOKENS,
+    )
     end = time.time()
 
+    answer = structured.parse(completion.choices[0].message.content)
+    return results.Explanation(
+        text=structured.render(answer),
+        model=completion.model or args.llm,
+        prompt_tokens=completion.usage.prompt_tokens,
+        completion_tokens=completion.usage.completion_tokens,
+        latency=end - start,
+    )
+
+
+async def explain_bundle(
+    client: engine.Client, args: argparse.Namespace, requests: List[str]
+) -> List[Union[results.Explanation, openai.OpenAIError]]:
+    """
+    Explains several prompts with a single request, see packing.py. Token counts are
+    split between the answers, which are cached under their own prompt. Prompts the
+    model did not answer are sent again on their own.
+    """
+    start = time.time()
+    completion = await complete(
+        client,
+        args,
+        packing.bundle_prompt(requests),
+        response_format=packing.RESPONSE_FORMAT,
+    )
+    latency = time.time() - start
+    answers = packing.unpack(completion.choices[0].message.content, len(requests))
 
-    text: str = completion.choices[0].message.content
-    if wrap:
-        text = llm_utils.word_wrap_except_code_blocks(text)
+    prompt_size = sum(len(prompt) for prompt in requests)
+    answers_size = sum(len(answer) for answer in answers if answer) or 1
+    explanations: List[Union[results.Explanation, openai.OpenAIError]] = []
+    for prompt, answer in zip(requests, answers):
+        if answer is None:
+            try:
+                explanations.append(await explain(client, args, prompt))
+            except openai.OpenAIError as e:
+                if endpoints.unreachable(e):
+                    raise
+                explanations.append(e)
+            continue
+        usage = completion.usage
+        explanation = results.Explanation(
+            text=answer,
+            model=completion.model or args.llm,
+            prompt_tokens=round(usage.prompt_tokens * len(prompt) / prompt_size),
+            completion_tokens=round(
+                usage.completion_tokens * len(answer) / answers_size
+            ),
+            latency=latency,
+        )
+        cache.put(args.llm, prompt, explanation)
+        explanations.append(explanation)
+    return explanations
+
+
+async def explain_cached(
+    client: engine.Client, args: argparse.Namespace, prompt: str
+) -> results.Explanation:
+    explanation = cache.get(args.llm, prompt)
+    if explanation is None:
+        explanation = await explain(client, args, prompt)
+        cache.put(args.llm, prompt, explanation)
+    return explanation
 
-    text += "\n\n"
-    text += f"({end - start:.1f} seconds, "
-    text += f"{completion.usage.prompt_tokens} prompt tokens, "
-    text += f"{completion.usage.completion_tokens} completion tokens.)"
 
-    return text
+def evaluate_text_prompt(
+    client: engine.Client, args: argparse.Namespace, prompt: str, wrap: bool = True
+) -> str:
+    # A structured answer that is cut off is asked for again, free-form.
+    deadline = 2 * args.timeout
+    return client.run(explain(client, args, prompt), deadline).format(wrap)
@@ -0,0 +1,223 @@
+"""
+Chooses where to send requests. When the API cannot be reached, for example on
+air-gapped build machines, requests go to the --fallback-url server instead, such
+as Ollama on the same machine, with prompts shrunk to fit its context window. A
+connection that is refused says so at once, one that is merely slow is left to the
+request, which falls back when it cannot connect either. When neither answers, the
+error locations are printed instead of an explanation.
+"""
+
+import argparse
+import dataclasses
+import json
+import os
+import socket
+import tempfile
+import threading
+import time
+import urllib.parse
+import urllib.request
+from typing import Dict, List, Optional, Tuple
+
+import openai
+
+from . import cache, frontends, results
+
+_default_url = "https://api.openai.com/v1"
+
+# A connection to an endpoint that is up takes a few milliseconds, one that is down
+# usually fails at once, or hangs when packets are dropped.
+_probe_timeout = 0.1
+# Seconds a probe is trusted by later runs. Failures are checked again sooner, so
+# that a restored connection is used quickly.
+_reachable_ttl = 300
+_unreachable_ttl = 30
+
+# Room for the instructions and the answer in the fallback model's context window.
+_reserved_tokens = 256 + 1024
+# Local models answer a request at a time, and much slower.
+_fallback_clusters = 3
+_fallback_timeout = 180
+_offline_locations = 10
+_offline_message_length = 120
+
+
+@dataclasses.dataclass
+class Endpoint:
+    # None for the OpenAI client's own, from OPENAI_BASE_URL.
+    url: Optional[str] = None
+    api_key: Optional[str] = None
+
+
+def _address(url: str) -> Optional[Tuple[str, int]]:
+    """
+    The host and port a connection to the URL goes through, the proxy's if any.
+    """
+    parsed = urllib.parse.urlsplit(url)
+    if not parsed.hostname:
+        return None
+    if not urllib.request.proxy_bypass(parsed.hostname):
+        proxy = urllib.request.getproxies().get(parsed.scheme)
+        if proxy:
+            parsed = urllib.parse.urlsplit(proxy)
+    port = parsed.port or (443 if parsed.scheme == "https" else 80)
+    return (parsed.hostname or "", port)
+
+
+def _probe(address: Tuple[str, int]) -> Optional[bool]:
+    """
+    Whether a connection opens, or None when the probe gave up waiting, which says
+    nothing about a slow network or proxy.
+    """
+    # Name resolution cannot be given a timeout, so the probe runs on a thread.
+    outcome: List[bool] = []
+    done = threading.Event()
+
+    def connect() -> None:
+        try:
+            socket.create_connection(address, timeout=_probe_timeout).close()
+            outcome.append(True)
+        except socket.timeout:
+            pass
+        except OSError:
+            outcome.append(False)
+        done.set()
+
+    threading.Thread(target=connect, daemon=True).start()
+    done.wait(_probe_timeout)
+    return outcome[0] if outcome else None
+
+
+def _health_path() -> str:
+    return os.path.join(cache.directory(), "health.json")
+
+
+def _load_health() -> Dict[str, Dict[str, float]]:
+    try:
+        with open(_health_path(), "r") as f:
+            return json.load(f)
+    except (OSError, ValueError):
+        return {}
+
+
+def _save_health(url: str, reachable: bool) -> None:
+    health = _load_health()
+    health[url] = {"reachable": reachable, "time": time.time()}
+    path = _health_path()
+    try:
+        os.makedirs(os.path.dirname(path), exist_ok=True)
+        handle, temporary = tempfile.mkstemp(dir=os.path.dirname(path))
+        with os.fdopen(handle, "w") as f:
+            json.dump(health, f)
+        os.replace(temporary, path)
+    except OSError:
+        pass
+
+
+def reachable(url: str) -> bool:
+    """
+    Whether a connection to the endpoint can be opened, from the health cache
+    shared by every run when recent enough. An inconclusive probe counts as
+    reachable and is not cached, the request itself tells.
+    """
+    entry = _load_health().get(url)
+    if entry:
+        ttl = _reachable_ttl if entry["reachable"] else _unreachable_ttl
+        if time.time() - entry["time"] < ttl:
+            return bool(entry["reachable"])
+    address = _address(url)
+    result = _probe(address) if address else False
+    if result is None:
+        return True
+    _save_health(url, result)
+    return result
+
+
+def _shrink(args: argparse.Namespace) -> None:
+    budget = max(256, (args.fallback_context - _reserved_tokens) // 2)
+    args.max_error_tokens = min(args.max_error_tokens, budget)
+    args.max_code_tokens = min(args.max_code_tokens, budget)
+    args.max_clusters = min(args.max_clusters, _fallback_clusters)
+    args.jobs = 1
+    args.llm = args.fallback_llm
+    args.timeout = max(args.timeout, _fallback_timeout)
+
+
+def primary_url() -> str:
+    return os.environ.get("OPENAI_BASE_URL") or _default_url
+
+
+def select(args: argparse.Namespace) -> Optional[Endpoint]:
+    """
+    The first endpoint of the chain that can be reached, the API then
+    --fallback-url, or None. Falling back adapts the prompt budgets and model in
+    args, so it must happen before prompts are built.
+    """
+    if reachable(primary_url()):
+        return Endpoint()
+    return _fallback(args)
+
+
+def _fallback(args: argparse.Namespace) -> Optional[Endpoint]:
+    if args.fallback_url and reachable(args.fallback_url):
+        _shrink(args)
+        # Local servers such as Ollama accept any key, but the client needs one.
+        return Endpoint(args.fallback_url, os.environ.get("OPENAI_API_KEY") or "none")
+    return None
+
+
+def unreachable(error: BaseException) -> bool:
+    """
+    Whether a request could not connect. Timeouts are connection errors too, but
+    the endpoint answered.
+    """
+    return isinstance(error, openai.APIConnectionError) and not isinstance(
+        error, openai.APITimeoutError
+    )
+
+
+def failed(args: argparse.Namespace, endpoint: Endpoint) -> Optional[Endpoint]:
+    """
+    Records that a request could not connect, for later runs to fall back at once,
+    and returns the next endpoint of the chain to try, if any.
+    """
+    _save_health(endpoint.url or primary_url(), False)
+    if endpoint.url is None:
+        return _fallback(args)
+    return None
+
+
+def offline(
+    diagnostic: str, clusters: List[frontends.ErrorCluster]
+) -> results.Explanation:
+    """
+    A notice listing where the errors are, for when no model can be reached.
+    """
+    if not clusters:
+        clusters = [frontends.from_diagnostic(diagnostic)]
+    lines = []
+    for cluster in clusters:
+        for record in cluster.records:
+            if not (record.file and record.line):
+                continue
+            message = record.message
+            # Records without a front end are whole lines, with the location, and
+            # include notes and instantiation contexts.
+            if message.startswith(record.file):
+                message = message.split(": ", 1)[-1]
+                if "error" not in message:
+                    continue
+            if len(message) > _offline_message_length:
+                message = message[: _offline_message_length - 3] + "..."
+            lines.append(f"- {record.location()}: {message}")
+    if not lines:
+        lines = [f"- {cluster.key}" for cluster in clusters]
+    more = len(lines) - _offline_locations
+    lines = lines[:_offline_locations]
+    if more > 0:
+        lines.append(f"- ... and {more} more.")
+    text = "No language model could be reached, so the errors were not explained. "
+    text += "They were reported at:\n\n" + "\n".join(lines)
+    return results.Explanation(
+        text=text, model="offline", prompt_tokens=0, completion_tokens=0, latency=0.0
+    )
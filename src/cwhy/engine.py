@@ -0,0 +1,113 @@
+"""
+Runs requests on the asynchronous OpenAI client, from an event loop on a
+background thread. Synchronous code submits coroutines and gets futures back, so
+concurrent explanations share one connection pool instead of a thread and a
+connection each. With h2 installed (`pip install cwhy[http2]`), requests are
+multiplexed over a single HTTP/2 connection.
+"""
+
+import argparse
+import asyncio
+import concurrent.futures
+import importlib.util
+import threading
+from typing import Any, Awaitable, Dict, Optional, TypeVar
+
+import openai
+
+from . import endpoints
+
+T = TypeVar("T")
+
+
+class DeadlineExceeded(openai.OpenAIError):
+    pass
+
+
+class Client:
+    """
+    At most --jobs requests are in flight at a time, each with a deadline of
+    --timeout seconds covering the retries of the OpenAI client. Leaving the
+    context cancels whatever is still running, for example after Ctrl-C.
+    """
+
+    def __init__(
+        self, args: argparse.Namespace, endpoint: Optional[endpoints.Endpoint] = None
+    ):
+        endpoint = endpoint or endpoints.Endpoint()
+        jobs = max(1, args.jobs)
+        self.timeout = args.timeout
+        self.loop = asyncio.new_event_loop()
+        self.thread = threading.Thread(target=self.loop.run_forever, daemon=True)
+        self.thread.start()
+
+        async def start() -> None:
+            # Created on the loop, which they belong to before Python 3.10.
+            self.slots = asyncio.Semaphore(jobs)
+            self.openai = openai.AsyncOpenAI(
+                base_url=endpoint.url,
+                api_key=endpoint.api_key,
+                http_client=openai.DefaultAsyncHttpxClient(
+                    http2=importlib.util.find_spec("h2") is not None
+                ),
+            )
+
+        try:
+            self.run(start(), self.timeout)
+        except BaseException:
+            # For example without an API key.
+            self.close()
+            raise
+
+    def __enter__(self) -> "Client":
+        return self
+
+    def __exit__(self, *exception: Any) -> None:
+        self.close()
+
+    def submit(self, coroutine: Awaitable[T]) -> "concurrent.futures.Future[T]":
+        return asyncio.run_coroutine_threadsafe(coroutine, self.loop)  # type: ignore
+
+    def run(self, coroutine: Awaitable[T], deadline: Optional[float] = None) -> T:
+        """
+        Waits at most deadline seconds, so that a loop that stopped running does
+        not leave the caller waiting forever.
+        """
+        future = self.submit(coroutine)
+        try:
+            return future.result(deadline)
+        except concurrent.futures.TimeoutError:
+            future.cancel()
+            raise DeadlineExceeded(f"No answer within {deadline} seconds.")
+        except BaseException:
+            future.cancel()
+            raise
+
+    async def create(
+        self, request: Dict[str, Any], deadline: Optional[float] = None
+    ) -> Any:
+        async with self.slots:
+            try:
+                return await asyncio.wait_for(
+                    self.openai.chat.completions.create(**request), deadline
+                )
+            except asyncio.TimeoutError:
+                raise DeadlineExceeded(f"No answer within {deadline} seconds.")
+
+    def close(self) -> None:
+        async def stop() -> None:
+            tasks = [
+                task
+                for task in asyncio.all_tasks()
+                if task is not asyncio.current_task()
+            ]
+            for task in tasks:
+                task.cancel()
+            await asyncio.gather(*tasks, return_exceptions=True)
+            if hasattr(self, "openai"):
+                await self.openai.close()
+
+        asyncio.run_coroutine_threadsafe(stop(), self.loop).result()
+        self.loop.call_soon_threadsafe(self.loop.stop)
+        self.thread.join()
+        self.loop.close()
@@ -0,0 +1,181 @@
+"""
+Shortens compile commands for prompts and tools. Build systems such as CMake pass
+hundreds of include directories, defines, warnings and code generation flags, most
+of which are irrelevant to a given error. The summary keeps the flags the
+diagnostic refers to, the language standard, anything turning warnings into errors,
+and every include directory when a header is missing, and counts the rest.
+"""
+
+import dataclasses
+import functools
+import os
+import re
+from typing import List, Optional, Set, Tuple
+
+# Options taking their value as the next argument when not attached.
+_include_options = ["-isystem", "-iquote", "-idirafter", "-I"]
+_define_options = ["-D", "-U"]
+
+# Options passing their comma-separated arguments to the preprocessor, assembler or
+# linker, rather than warning options.
+_passthrough_options = ["-Wp,", "-Wa,", "-Wl,"]
+
+# Header names in "file not found" errors.
+_missing_header_patterns = [
+    re.compile(r"fatal error: '?([^':]+?)'?: No such file or directory"),
+    re.compile(r"fatal error: '([^']+)' file not found"),
+]
+# Header names in include chains and code locations.
+_header_patterns = [
+    *_missing_header_patterns,
+    re.compile(r"^(?:In file included from|\s+from) (.+?):\d+[:,]"),
+    re.compile(r'#\s*include\s*[<"]([^>"]+)[>"]'),
+    # GCC and Clang locations.
+    re.compile(r"^([^\s:]+):\d+:(?:\d+:)? "),
+]
+_identifier = re.compile(r"[A-Za-z_]\w*")
+# Options named in diagnostics, such as `[-Werror=unused-variable]` or
+# `-fno-exceptions`.
+_option_pattern = re.compile(r"-[fW][\w+.=-]+")
+
+
+@dataclasses.dataclass
+class _Flag:
+    # include, define, warning, error, feature, passthrough or other.
+    kind: str
+    # The arguments making up the flag, one or two.
+    arguments: List[str]
+    # The include directory or macro name.
+    value: Optional[str] = None
+
+
+def _split(argument: str, options: List[str]) -> Optional[Tuple[str, str]]:
+    for option in options:
+        if argument.startswith(option):
+            return option, argument[len(option) :]
+    return None
+
+
+@functools.lru_cache(maxsize=64)
+def _parse(command: Tuple[str, ...]) -> List[_Flag]:
+    """
+    Classifies the arguments of a command, cached since a tool may ask for the same
+    command several times during a conversation.
+    """
+    flags: List[_Flag] = []
+    arguments = iter(command)
+    for argument in arguments:
+        include = _split(argument, _include_options)
+        define = _split(argument, _define_options)
+        if include:
+            option, value = include
+            group = [argument] if value else [option, next(arguments, "")]
+            flags.append(_Flag("include", group, value or group[-1]))
+        elif define:
+            option, value = define
+            group = [argument] if value else [option, next(arguments, "")]
+            name = (value or group[-1]).split("=", 1)[0]
+            flags.append(_Flag("define", group, name))
+        elif argument.startswith(tuple(_passthrough_options)):
+            flags.append(_Flag("passthrough", [argument]))
+        elif argument.startswith("-Werror") or argument == "-pedantic-errors":
+            flags.append(_Flag("error", [argument]))
+        elif argument.startswith("-W") and len(argument) > 2:
+            flags.append(_Flag("warning", [argument]))
+        elif argument.startswith("-f") and len(argument) > 2:
+            flags.append(_Flag("feature", [argument]))
+        else:
+            flags.append(_Flag("other", [argument]))
+    return flags
+
+
+def include_directories(command: List[str]) -> List[str]:
+    return [
+        flag.value
+        for flag in _parse(tuple(command))
+        if flag.kind == "include" and flag.value
+    ]
+
+
+def _option_name(option: str) -> str:
+    """
+    The name shared by an option's forms: `unused-variable` for -Wunused-variable,
+    -Wno-unused-variable and -Werror=unused-variable, `exceptions` for
+    -fno-exceptions.
+    """
+    name = option[2:].split("=", 1)[-1] if option.startswith("-Werror=") else option
+    name = name[2:] if name.startswith(("-W", "-f")) else name
+    return name[3:] if name.startswith("no-") else name
+
+
+def _mentioned(flag: _Flag, options: Set[str], identifiers: Set[str]) -> bool:
+    name = _option_name(flag.arguments[0])
+    if name in options:
+        return True
+    # Messages such as "cannot use 'throw' with exceptions disabled" name the
+    # feature, but not the option.
+    return flag.kind == "feature" and name in identifiers
+
+
+def _referenced_headers(
+    diagnostic: str, patterns: List["re.Pattern[str]"] = _header_patterns
+) -> Set[str]:
+    headers = set()
+    for line in diagnostic.splitlines():
+        for pattern in patterns:
+            match = pattern.search(line)
+            if match:
+                headers.add(match.group(1))
+    return headers
+
+
+def _relevant_directory(directory: str, headers: Set[str]) -> bool:
+    absolute = os.path.abspath(directory)
+    for header in headers:
+        if os.path.isabs(header):
+            if os.path.abspath(header).startswith(absolute + os.sep):
+                return True
+        elif os.path.isfile(os.path.join(directory, header)):
+            return True
+    return False
+
+
+def summarize(command: List[str], diagnostic: str) -> str:
+    """
+    The command with the include directories, defines, warnings and -f flags
+    unrelated to the diagnostic left out and counted.
+    """
+    flags = _parse(tuple(command))
+    identifiers = set(_identifier.findall(diagnostic))
+    headers = _referenced_headers(diagnostic)
+    # Where the compiler looked for a header it did not find.
+    missing_header = bool(_referenced_headers(diagnostic, _missing_header_patterns))
+    options = {_option_name(option) for option in _option_pattern.findall(diagnostic)}
+
+    kept: List[str] = []
+    omitted = {"include": 0, "define": 0, "warning": 0, "feature": 0}
+    for flag in flags:
+        if flag.kind == "include":
+            keep = missing_header or _relevant_directory(flag.value or "", headers)
+        elif flag.kind == "define":
+            keep = flag.value in identifiers
+        elif flag.kind in ["warning", "feature"]:
+            keep = _mentioned(flag, options, identifiers)
+        else:
+            keep = flag.kind not in omitted
+        if keep:
+            kept += flag.arguments
+        else:
+            omitted[flag.kind] += 1
+
+    names = {
+        "include": "include directories",
+        "define": "defines",
+        "warning": "warning flags",
+        "feature": "-f flags",
+    }
+    counts = [f"{n} {names[kind]}" for kind, n in omitted.items() if n]
+    summary = " ".join(kept)
+    if counts:
+        summary += f" [{', '.join(counts)} omitted]"
+    return summary
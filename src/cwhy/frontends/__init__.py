@@ -0,0 +1,72 @@
+import argparse
+from typing import List, Optional
+
+from .. import preprocess
+from .clang_tidy import ClangTidy
+from .dotnet import DotNet
+from .go import Go
+from .haskell import Haskell
+from .jvm import JVM
+from .latex import LaTeX
+from .python import Python
+from .records import (
+    ErrorCluster,
+    ErrorRecord,
+    FrontEnd,
+    cluster_records,
+    fingerprint,
+)
+from .swift import Swift
+from .typescript import TypeScript
+
+_frontends = [
+    TypeScript,
+    JVM,
+    LaTeX,
+    Go,
+    DotNet,
+    Python,
+    Swift,
+    Haskell,
+    ClangTidy,
+]
+
+
+def detect(args: argparse.Namespace) -> Optional[FrontEnd]:
+    """
+    Returns the front end for the wrapped command, or None to fall back to scanning
+    the raw output with the regular expressions in prompts.py.
+    """
+    for frontend in _frontends:
+        if frontend.matches(args.command):
+            return frontend(args)
+    return None
+
+
+def summarize(clusters: List[ErrorCluster]) -> str:
+    """
+    A compact replacement for the raw output, with one entry per cluster.
+    """
+    return "\n\n".join(cluster.diagnostic() for cluster in clusters)
+
+
+def from_diagnostic(diagnostic: str) -> ErrorCluster:
+    """
+    Wraps raw output without a front end as a single cluster, with one record per
+    line referring to a code location.
+    """
+    # prompts imports the results, which import the records from here.
+    from .. import prompts
+
+    lines = [line for line in preprocess.lines(diagnostic) if line.strip()]
+    records = []
+    for line in lines:
+        location = prompts.match_location(line)
+        if location:
+            records.append(
+                ErrorRecord(file=location[0], line=location[1], message=line.strip())
+            )
+    if not records:
+        records.append(ErrorRecord(message=lines[0].strip() if lines else ""))
+    # The first error is used as the title of the cluster.
+    return ErrorCluster(records[0].message, records)
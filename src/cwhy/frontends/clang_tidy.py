@@ -0,0 +1,200 @@
+import dataclasses
+import os
+import re
+from typing import Any, Dict, List, Optional, Tuple
+
+import yaml
+
+from .records import ErrorRecord, FrontEnd, executable
+
+# `src/a.cpp:12:5: warning: message [check-name,other-check]`.
+_finding_pattern = re.compile(
+    r"(.+?):(\d+):(\d+): (warning|error): (.*?)(?: \[([\w.,-]+)\])?$"
+)
+_note_pattern = re.compile(r"(.+?):(\d+):(\d+): note: (.*)")
+# Names and values that differ between findings of the same kind.
+_quoted_pattern = re.compile(r"'[^']*'")
+_number_pattern = re.compile(r"\b\d+\b")
+
+
+@dataclasses.dataclass
+class Replacement:
+    path: str
+    # In bytes.
+    offset: int
+    length: int
+    text: str
+
+
+def pattern(message: str) -> str:
+    """
+    The message with quoted names and numbers elided, shared by the findings of a
+    check with the same cause, e.g. "variable '…' is not initialized".
+    """
+    return _number_pattern.sub("N", _quoted_pattern.sub("'…'", message))
+
+
+def parse_output(text: str) -> List[ErrorRecord]:
+    """
+    Findings printed by clang-tidy or run-clang-tidy, with their notes. A finding
+    reported once per translation unit including a header is kept once.
+    """
+    records: List[ErrorRecord] = []
+    seen = set()
+    current: Optional[ErrorRecord] = None
+    for line in text.splitlines():
+        match = _finding_pattern.match(line)
+        if match:
+            file, row, column, _, message, checks = match.groups()
+            key = (os.path.normpath(file), row, column, message)
+            if key in seen:
+                current = None
+                continue
+            seen.add(key)
+            current = ErrorRecord(
+                file=file,
+                line=int(row),
+                column=int(column),
+                code=checks.split(",")[0] if checks else "clang-diagnostic",
+                message=message,
+            )
+            records.append(current)
+            continue
+        match = _note_pattern.match(line)
+        if match and current is not None:
+            current.details.append(line)
+    return records
+
+
+class _Lines:
+    """
+    Converts byte offsets to line and column numbers, reading each file once.
+    """
+
+    def __init__(self) -> None:
+        self.starts: Dict[str, List[int]] = {}
+
+    def position(self, path: str, offset: int) -> Tuple[Optional[int], Optional[int]]:
+        if path not in self.starts:
+            try:
+                with open(path, "rb") as f:
+                    content = f.read()
+            except OSError:
+                return None, None
+            starts = [0]
+            starts += [m.end() for m in re.finditer(b"\n", content)]
+            self.starts[path] = starts
+        starts = self.starts[path]
+        low, high = 0, len(starts) - 1
+        while low < high:
+            middle = (low + high + 1) // 2
+            if starts[middle] <= offset:
+                low = middle
+            else:
+                high = middle - 1
+        return low + 1, offset - starts[low] + 1
+
+
+def _load(text: str) -> List[Any]:
+    loader = getattr(yaml, "CSafeLoader", yaml.SafeLoader)
+    return [document for document in yaml.load_all(text, loader) if document]
+
+
+def parse_fixes(text: str) -> Tuple[List[ErrorRecord], List[Replacement]]:
+    """
+    Findings and replacements from a `--export-fixes` YAML file. Each file may hold
+    several documents, for example when concatenated by run-clang-tidy.
+    """
+    records: List[ErrorRecord] = []
+    replacements: List[Replacement] = []
+    lines = _Lines()
+    seen = set()
+    for document in _load(text):
+        directory = document.get("BuildDirectory") or ""
+        for diagnostic in document.get("Diagnostics") or []:
+            body = diagnostic.get("DiagnosticMessage") or diagnostic
+            # Relative paths are relative to where the compiler ran.
+            build_directory = diagnostic.get("BuildDirectory", directory)
+            path = body.get("FilePath") or ""
+            if path and not os.path.isabs(path):
+                path = os.path.join(build_directory, path)
+            offset = int(body.get("FileOffset") or 0)
+            message = body.get("Message", "")
+            key = (path, offset, message)
+            if key in seen:
+                continue
+            seen.add(key)
+            row, column = lines.position(path, offset) if path else (None, None)
+            records.append(
+                ErrorRecord(
+                    file=path or None,
+                    line=row,
+                    column=column,
+                    code=diagnostic.get("DiagnosticName"),
+                    message=message,
+                )
+            )
+            for replacement in body.get("Replacements") or []:
+                replacement_path = replacement["FilePath"]
+                if not os.path.isabs(replacement_path):
+                    replacement_path = os.path.join(build_directory, replacement_path)
+                replacements.append(
+                    Replacement(
+                        path=replacement_path,
+                        offset=int(replacement["Offset"]),
+                        length=int(replacement["Length"]),
+                        text=replacement.get("ReplacementText") or "",
+                    )
+                )
+    return records, replacements
+
+
+def apply(replacements: List[Replacement]) -> Tuple[int, int, int]:
+    """
+    Applies the replacements to their files, each identical replacement once.
+    Replacements overlapping one already applied are skipped. Returns the number
+    applied, the number skipped, and the number of files changed.
+    """
+    by_path: Dict[str, List[Replacement]] = {}
+    for replacement in replacements:
+        by_path.setdefault(os.path.normpath(replacement.path), []).append(replacement)
+
+    applied = skipped = 0
+    for path, group in by_path.items():
+        unique = {(r.offset, r.length, r.text): r for r in group}
+        chosen: List[Replacement] = []
+        end = -1
+        for r in sorted(unique.values(), key=lambda r: (r.offset, r.length)):
+            # Insertions at the same offset as a previous change are conflicts too.
+            if r.offset < end or (chosen and r.offset == chosen[-1].offset):
+                skipped += 1
+                continue
+            chosen.append(r)
+            end = r.offset + r.length
+        with open(path, "rb") as f:
+            content = f.read()
+        for r in reversed(chosen):
+            content = (
+                content[: r.offset] + r.text.encode() + content[r.offset + r.length :]
+            )
+        with open(path, "wb") as f:
+            f.write(content)
+        applied += len(chosen)
+    return applied, skipped, len(by_path)
+
+
+class ClangTidy(FrontEnd):
+    @staticmethod
+    def matches(command: List[str]) -> bool:
+        name = executable(command) or ""
+        return name.startswith(("clang-tidy", "run-clang-tidy"))
+
+    def has_findings(self, stdout: str, stderr: str) -> bool:
+        # Warnings do not change the exit status.
+        return bool(self.parse(stdout, stderr))
+
+    def parse(self, stdout: str, stderr: str) -> List[ErrorRecord]:
+        return parse_output(stdout + "\n" + stderr)
+
+    def key(self, record: ErrorRecord) -> str:
+        return f"{record.code}: {pattern(record.message)}"
@@ -0,0 +1,121 @@
+import argparse
+import os
+import re
+import tempfile
+from typing import Dict, List, Optional, Tuple
+
+from .records import ErrorRecord, FrontEnd, executable, executable_index
+
+# `/src/Program.cs(13,44): error CS1010: Newline in constant [/src/app.csproj]`. The
+# location may be a span, `(13,44,13,50)`, and the project suffix is optional.
+_error_pattern = re.compile(
+    r"\s*(.+?)\((\d+),(\d+)(?:,(\d+),(\d+))?\): error (\w+): (.*?)(?: \[([^\]]+)\])?$"
+)
+# Errors without a location, e.g. `CSC : error CS5001: Program does not contain...`.
+_tool_error_pattern = re.compile(r"\s*(.+?) : error (\w+): (.*?)(?: \[([^\]]+)\])?$")
+
+_log_switch = "-flp9:"
+_subcommands = ["build", "msbuild", "test", "publish", "pack", "run"]
+# `dotnet run` passes options it does not know on to the program, so its console
+# output is read instead.
+_unlogged_subcommands = ["run"]
+
+
+class DotNet(FrontEnd):
+    """
+    Reads C# diagnostics from MSBuild's errors-only file logger rather than the
+    console, which prints every error twice (inline, then in the build summary).
+    """
+
+    @staticmethod
+    def matches(command: List[str]) -> bool:
+        name = executable(command)
+        if name == "msbuild":
+            return True
+        index = executable_index(command)
+        return (
+            name == "dotnet"
+            and index is not None
+            and len(command) > index + 1
+            and command[index + 1] in _subcommands
+        )
+
+    def __init__(self, args: argparse.Namespace):
+        super().__init__(args)
+        # The log file created by prepare(), rather than one the user asked for.
+        self.temporary: Optional[str] = None
+
+    def prepare(self, command: List[str]) -> List[str]:
+        if self.log_path(command):
+            return command
+        index = (executable_index(command) or 0) + 1
+        if index < len(command) and command[index] in _unlogged_subcommands:
+            return command
+        # The ninth file logger is very unlikely to be used by the build itself.
+        handle, self.temporary = tempfile.mkstemp(prefix="cwhy-", suffix=".log")
+        os.close(handle)
+        switch = f"{_log_switch}LogFile={self.temporary};ErrorsOnly;Encoding=UTF-8"
+        # Arguments after `--` go to the test runner.
+        index = command.index("--") if "--" in command else len(command)
+        return [*command[:index], switch, *command[index:]]
+
+    def cleanup(self) -> None:
+        if self.temporary and os.path.exists(self.temporary):
+            os.remove(self.temporary)
+
+    @staticmethod
+    def log_path(command: List[str]) -> Optional[str]:
+        for argument in command:
+            if argument == "--":
+                break
+            if argument.startswith(_log_switch):
+                for parameter in argument[len(_log_switch) :].split(";"):
+                    if parameter.startswith("LogFile="):
+                        return parameter[len("LogFile=") :]
+        return None
+
+    def parse(self, stdout: str, stderr: str) -> List[ErrorRecord]:
+        path = self.log_path(self.args.command)
+        lines = (stdout + "\n" + stderr).splitlines()
+        if path and os.path.isfile(path):
+            with open(path, "r", encoding="utf-8", errors="replace") as f:
+                # Empty when MSBuild failed before loggers were set up.
+                lines = f.read().splitlines() or lines
+
+        records: List[ErrorRecord] = []
+        # Deduplicate, a multi-targeted project also reports each error per target.
+        seen: Dict[Tuple, ErrorRecord] = {}
+        for line in lines:
+            match = _error_pattern.match(line)
+            if match:
+                (file, line_number, column, end_line, end_column) = match.groups()[:5]
+                code, message, project = match.groups()[5:]
+                record = ErrorRecord(
+                    file=file,
+                    line=int(line_number),
+                    column=int(column),
+                    end_line=int(end_line) if end_line else None,
+                    end_column=int(end_column) if end_column else None,
+                    code=code,
+                    message=message,
+                )
+            else:
+                match = _tool_error_pattern.match(line)
+                if not match:
+                    continue
+                tool, code, message, project = match.groups()
+                record = ErrorRecord(code=code, message=f"{tool}: {message}")
+            if project:
+                # Multi-targeted projects are `app.csproj::TargetFramework=net8.0`.
+                project = project.split("::")[0]
+                record.group = os.path.splitext(os.path.basename(project))[0]
+
+            key = (record.location(), record.code, record.message)
+            if key in seen:
+                continue
+            seen[key] = record
+            records.append(record)
+        return records
+
+    def key(self, record: ErrorRecord) -> str:
+        return f"{record.code}: {record.message}"
@@ -0,0 +1,275 @@
+import argparse
+import json
+import re
+import subprocess
+from typing import Any, Dict, Iterator, List, Optional, Tuple, Union
+
+from .records import ErrorRecord, FrontEnd, executable, executable_index
+
+# `./testme.go:6:30: newline in string`, the column is optional. Plain `go vet`
+# prefixes errors of packages that do not build with `vet: `.
+_error_pattern = re.compile(r"\s*(?:vet: )?(.+?\.go):(\d+)(?::(\d+))?: (.*)")
+_version_pattern = re.compile(r"go(\d+)\.(\d+)")
+
+
+def _supports_build_json(go: str) -> bool:
+    # `go build -json` was added in Go 1.24, `go test -json` and `go vet -json` are
+    # much older.
+    try:
+        process = subprocess.run(
+            [go, "env", "GOVERSION"],
+            stdout=subprocess.PIPE,
+            stderr=subprocess.DEVNULL,
+            text=True,
+        )
+    except OSError:
+        return False
+    match = _version_pattern.match(process.stdout.strip())
+    if not match:
+        return False
+    return (int(match.group(1)), int(match.group(2))) >= (1, 24)
+
+
+def _package(name: Optional[str]) -> Optional[str]:
+    # Test variants are reported as `example.com/pkg [example.com/pkg.test]`.
+    return name.split(" ")[0] if name else name
+
+
+def _split(text: str) -> Iterator[Union[str, Dict[str, Any]]]:
+    """
+    Yields plain lines as they are, and JSON events and the multi-line objects
+    printed by `go vet -json` parsed.
+    """
+    vet_lines: List[str] = []
+    for line in text.splitlines():
+        if vet_lines or line == "{":
+            vet_lines.append(line)
+            if line == "}":
+                try:
+                    yield json.loads("\n".join(vet_lines))
+                except json.JSONDecodeError:
+                    yield from vet_lines
+                vet_lines = []
+            continue
+        if line.startswith("{"):
+            try:
+                yield json.loads(line)
+                continue
+            except json.JSONDecodeError:
+                pass
+        yield line
+    # Cut off before the closing brace.
+    yield from vet_lines
+
+
+def _findings(findings: Any) -> List[Dict[str, Any]]:
+    if not isinstance(findings, list):
+        # For example {"error": "..."} when the package does not build.
+        findings = [{"message": findings.get("error", str(findings))}]
+    return findings
+
+
+class Go(FrontEnd):
+    """
+    Reads the JSON event streams of `go build`, `go vet`, and `go test`.
+    """
+
+    def __init__(self, args: argparse.Namespace):
+        super().__init__(args)
+        # Whether -json was added by prepare() rather than by the user.
+        self.json_requested = False
+
+    @staticmethod
+    def matches(command: List[str]) -> bool:
+        return executable(command) == "go" and Go.subcommand(command) in [
+            "build",
+            "vet",
+            "test",
+        ]
+
+    @staticmethod
+    def subcommand_index(command: List[str]) -> Optional[int]:
+        index = (executable_index(command) or 0) + 1
+        while index < len(command):
+            argument = command[index]
+            if argument == "-C":
+                # `go -C dir build`, the only flag allowed before the subcommand.
+                index += 2
+                continue
+            if not argument.startswith("-"):
+                return index
+            index += 1
+        return None
+
+    @staticmethod
+    def subcommand(command: List[str]) -> Optional[str]:
+        index = Go.subcommand_index(command)
+        return command[index] if index is not None else None
+
+    def prepare(self, command: List[str]) -> List[str]:
+        # The JSON streams are only useful to us, keep diff-converse on plain output.
+        if self.args.subcommand != "explain" or "-json" in command:
+            return command
+        index = self.subcommand_index(command)
+        assert index is not None
+        go = command[executable_index(command) or 0]
+        if command[index] == "build" and not _supports_build_json(go):
+            return command
+        command = list(command)
+        command.insert(index + 1, "-json")
+        self.json_requested = True
+        return command
+
+    def display(self, stdout: str, stderr: str) -> Tuple[str, str]:
+        if not self.json_requested:
+            return (stdout, stderr)
+        return (self.render(stdout), self.render(stderr))
+
+    @staticmethod
+    def render(text: str) -> str:
+        """
+        Rebuilds the plain output from the events: what the compiler printed, the
+        output of failed tests, and the package results.
+        """
+        lines: List[str] = []
+        tests: Dict[Any, List[str]] = {}
+        for item in _split(text):
+            if isinstance(item, str):
+                lines.append(item)
+                continue
+            action = item.get("Action")
+            output = item.get("Output", "").rstrip("\n")
+            if action is None:
+                for package, analyzers in item.items():
+                    lines.append(f"# {package}")
+                    for findings in analyzers.values():
+                        for finding in _findings(findings):
+                            posn = finding.get("posn")
+                            message = finding.get("message", "")
+                            lines.append(f"{posn}: {message}" if posn else message)
+            elif action == "build-output":
+                lines.append(output)
+            elif action == "output" and item.get("Test"):
+                key = (item.get("Package"), item["Test"])
+                tests.setdefault(key, []).append(output)
+            elif action == "output":
+                lines.append(output)
+            elif action == "fail" and item.get("Test"):
+                lines.extend(tests.pop((item.get("Package"), item["Test"]), []))
+        return "\n".join(lines)
+
+    def vet_json(self) -> bool:
+        # `go vet -json` exits successfully even when it reports diagnostics.
+        return (
+            self.subcommand(self.args.command) == "vet" and "-json" in self.args.command
+        )
+
+    def returncode(self, returncode: int, stdout: str, stderr: str) -> int:
+        # Keep the status of the plain `go vet` the user ran.
+        if returncode == 0 and self.json_requested and self.vet_json():
+            if self.parse(stdout, stderr):
+                return 1
+        return returncode
+
+    def has_findings(self, stdout: str, stderr: str) -> bool:
+        # The user ran `go vet -json`, whose status is theirs to keep.
+        if self.json_requested or not self.vet_json():
+            return False
+        return bool(self.parse(stdout, stderr))
+
+    def parse(self, stdout: str, stderr: str) -> List[ErrorRecord]:
+        records: List[ErrorRecord] = []
+        # Output of each running test, keyed by (package, test).
+        tests: Dict[Any, List[str]] = {}
+        package: Optional[str] = None
+
+        def add_output(package: Optional[str], output: str) -> None:
+            for line in output.splitlines():
+                match = _error_pattern.match(line)
+                if match:
+                    records.append(
+                        ErrorRecord(
+                            file=match.group(1),
+                            line=int(match.group(2)),
+                            column=int(match.group(3)) if match.group(3) else None,
+                            message=match.group(4),
+                            group=package,
+                        )
+                    )
+                elif line.startswith("\t") and records:
+                    # Continuation of the previous compiler error.
+                    records[-1].details.append(line)
+
+        for event in _split(stdout + "\n" + stderr):
+            if isinstance(event, str):
+                # Plain output: package headers and errors not wrapped in events.
+                if event.startswith("# "):
+                    package = _package(event[2:])
+                else:
+                    add_output(package, event)
+                continue
+
+            action = event.get("Action")
+            if action is None:
+                # An object printed by `go vet -json`.
+                self.add_vet_diagnostics(records, event)
+            elif action == "build-output":
+                output = event.get("Output", "")
+                if not output.startswith("# "):
+                    add_output(_package(event.get("ImportPath")), output)
+            elif action == "output" and event.get("Test"):
+                key = (event["Package"], event["Test"])
+                tests.setdefault(key, []).append(event.get("Output", "").rstrip())
+            elif action == "fail" and event.get("Test"):
+                key = (event["Package"], event["Test"])
+                self.add_test_failure(records, key[0], key[1], tests.pop(key, []))
+        return records
+
+    def add_vet_diagnostics(
+        self, records: List[ErrorRecord], diagnostics: Dict[str, Any]
+    ) -> None:
+        for package, analyzers in diagnostics.items():
+            for analyzer, findings in analyzers.items():
+                for finding in _findings(findings):
+                    match = _error_pattern.match(finding.get("posn", "") + ": ")
+                    records.append(
+                        ErrorRecord(
+                            file=match.group(1) if match else None,
+                            line=int(match.group(2)) if match else None,
+                            column=(
+                                int(match.group(3))
+                                if match and match.group(3)
+                                else None
+                            ),
+                            code=analyzer,
+                            message=finding.get("message", ""),
+                            group=package,
+                        )
+                    )
+
+    def add_test_failure(
+        self, records: List[ErrorRecord], package: str, test: str, output: List[str]
+    ) -> None:
+        # Drop blank lines and the `=== RUN` and `--- FAIL` framing lines.
+        lines = [
+            line
+            for line in output
+            if line.strip() and not line.lstrip().startswith(("===", "---"))
+        ]
+        record = ErrorRecord(
+            code=test,
+            message=lines[0].strip() if lines else "test failed",
+            group=package,
+            details=lines[1:],
+        )
+        for line in lines:
+            match = _error_pattern.match(line)
+            if match:
+                record.file = match.group(1)
+                record.line = int(match.group(2))
+                record.message = match.group(4)
+                break
+        records.append(record)
+
+    def key(self, record: ErrorRecord) -> str:
+        return f"[{record.group or '?'}] {record.message}"
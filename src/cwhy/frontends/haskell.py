@@ -0,0 +1,204 @@
+import argparse
+import json
+import re
+import subprocess
+from typing import Any, Dict, List, Optional, Tuple
+
+from .records import ErrorRecord, FrontEnd, executable, executable_index
+
+# `testme.hs:3:9: error: [GHC-39999]`, or with a span, `testme.hs:(3,9)-(4,12): ...`.
+_error_pattern = re.compile(
+    r"(.+?\.l?hs):(?:(\d+):(\d+)(?:-\d+)?|\((\d+),(\d+)\)-\(\d+,\d+\)): error:"
+    r"(?: \[([\w-]+)\])?\s*(.*)"
+)
+# Source excerpts: `  |` and `3 | plot1 = ...`.
+_excerpt_pattern = re.compile(r"\s*\d*\s*\|")
+# Bullets that only repeat the surrounding code, or list candidates at length.
+_verbose_bullets = ["Relevant bindings include"]
+_listing_headers = ["Potentially matching instance", "Probable fix"]
+_MAX_LISTING = 2
+
+
+def _trim(lines: List[str]) -> List[str]:
+    """
+    Reduce a GHC message to the parts that matter, for example the expected and
+    actual types of a mismatch, dropping repeated context and long listings.
+    """
+    result: List[str] = []
+    skipping = False
+    context = False
+    listing: Optional[int] = None
+    for line in lines:
+        stripped = line.strip()
+        if not stripped or _excerpt_pattern.match(line):
+            continue
+        if stripped.startswith("•"):
+            body = stripped[1:].strip()
+            skipping = any(body.startswith(b) for b in _verbose_bullets)
+            # "In the expression: ..." is followed by every enclosing definition.
+            context = body.startswith("In ")
+            listing = None
+            if not skipping:
+                result.append(line)
+            continue
+        if skipping or context:
+            continue
+        if any(stripped.startswith(h) for h in _listing_headers):
+            listing = 0
+            result.append(line)
+            continue
+        if listing is not None:
+            listing += 1
+            if listing == _MAX_LISTING + 1:
+                result.append(line[: len(line) - len(line.lstrip())] + "...")
+            if listing > _MAX_LISTING:
+                continue
+        result.append(line)
+    return result
+
+
+def _version(ghc: str) -> Optional[List[int]]:
+    try:
+        process = subprocess.run(
+            [ghc, "--numeric-version"],
+            stdout=subprocess.PIPE,
+            stderr=subprocess.DEVNULL,
+            text=True,
+        )
+    except OSError:
+        return None
+    match = re.match(r"(\d+)\.(\d+)", process.stdout.strip())
+    return [int(match.group(1)), int(match.group(2))] if match else None
+
+
+def _render(diagnostic: Dict[str, Any]) -> List[str]:
+    """
+    The text GHC prints for a JSON diagnostic, without the source excerpt.
+    """
+    span = diagnostic.get("span")
+    severity = str(diagnostic.get("severity", "error")).lower()
+    if span:
+        start = span.get("start") or {}
+        header = f"{span.get('file')}:{start.get('line')}:{start.get('column')}: "
+    else:
+        header = "<no location info>: "
+    header += f"{severity}:"
+    code = diagnostic.get("code")
+    if isinstance(code, int):
+        header += f" [GHC-{code:05d}]"
+    lines = [header]
+    for bullet in diagnostic.get("message", []):
+        bullet_lines = bullet.splitlines() or [""]
+        lines.append(f"    • {bullet_lines[0]}")
+        lines.extend(f"      {line}" for line in bullet_lines[1:])
+    return lines
+
+
+class Haskell(FrontEnd):
+    """
+    GHC diagnostics, as JSON when available, with long messages trimmed.
+    """
+
+    def __init__(self, args: argparse.Namespace):
+        super().__init__(args)
+        # Whether -fdiagnostics-as-json was added by prepare() rather than the user.
+        self.json_requested = False
+
+    @staticmethod
+    def matches(command: List[str]) -> bool:
+        return re.match(r"ghc(-[\d.]+)?$", executable(command) or "") is not None
+
+    def prepare(self, command: List[str]) -> List[str]:
+        if "-fdiagnostics-as-json" in command:
+            return command
+        # Added in GHC 9.10.
+        version = _version(command[executable_index(command) or 0])
+        if not version or version < [9, 10]:
+            return command
+        self.json_requested = True
+        return [*command, "-fdiagnostics-as-json"]
+
+    def display(self, stdout: str, stderr: str) -> Tuple[str, str]:
+        if not self.json_requested:
+            return (stdout, stderr)
+        return (self.render(stdout), self.render(stderr))
+
+    @staticmethod
+    def render(text: str) -> str:
+        lines: List[str] = []
+        for line in text.splitlines():
+            if line.startswith("{"):
+                try:
+                    lines.extend([*_render(json.loads(line)), ""])
+                    continue
+                except (json.JSONDecodeError, AttributeError):
+                    pass
+            lines.append(line)
+        return "\n".join(lines)
+
+    def parse(self, stdout: str, stderr: str) -> List[ErrorRecord]:
+        records: List[ErrorRecord] = []
+        current: Optional[ErrorRecord] = None
+        lines: List[str] = []
+
+        def finish() -> None:
+            if current:
+                trimmed = _trim(lines)
+                if not current.message and trimmed:
+                    current.message = trimmed.pop(0).strip().lstrip("• ")
+                current.details = trimmed
+
+        for line in (stdout + "\n" + stderr).splitlines():
+            if line.startswith("{"):
+                try:
+                    diagnostic = json.loads(line)
+                except json.JSONDecodeError:
+                    continue
+                record = self.from_json(diagnostic)
+                if record:
+                    records.append(record)
+                continue
+
+            match = _error_pattern.match(line)
+            if match:
+                finish()
+                current = ErrorRecord(
+                    file=match.group(1),
+                    line=int(match.group(2) or match.group(4)),
+                    column=int(match.group(3) or match.group(5)),
+                    code=match.group(6),
+                    message=match.group(7),
+                )
+                lines = []
+                records.append(current)
+            elif current and (line.startswith(" ") or not line.strip()):
+                lines.append(line)
+            else:
+                finish()
+                current = None
+        finish()
+        return records
+
+    def from_json(self, diagnostic: Dict[str, Any]) -> Optional[ErrorRecord]:
+        if diagnostic.get("severity") != "Error":
+            return None
+        span = diagnostic.get("span") or {}
+        start = span.get("start") or {}
+        end = span.get("end") or {}
+        lines: List[str] = []
+        for bullet in diagnostic.get("message", []):
+            bullet_lines = bullet.splitlines() or [""]
+            lines.append(f"• {bullet_lines[0]}")
+            lines.extend(f"  {line}" for line in bullet_lines[1:])
+        trimmed = _trim(lines)
+        code = diagnostic.get("code")
+        return ErrorRecord(
+            file=span.get("file"),
+            line=start.get("line"),
+            column=start.get("column"),
+            end_line=end.get("line"),
+            end_column=end.get("column"),
+            code=f"GHC-{code:05d}" if isinstance(code, int) else None,
+            message=trimmed[0].lstrip("• ") if trimmed else "",
+            details=trimmed[1:],
+        )
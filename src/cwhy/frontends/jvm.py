@@ -0,0 +1,123 @@
+import re
+from typing import Dict, List, Optional, Tuple
+
+from .. import preprocess
+from .records import ErrorRecord, FrontEnd, executable
+
+_level_pattern = re.compile(r"\[(ERROR|WARNING|INFO|DEBUG)\] ?(.*)")
+
+# Module banners.
+_maven_building_pattern = re.compile(
+    r"Building ([^\s:]+)(?: [^\s:]+)?(?:\s+\[\d+/\d+\])?$"
+)
+_maven_plugin_pattern = re.compile(r"--- .* @ (\S+) ---")
+_maven_summary_pattern = re.compile(r"Failed to execute goal .* on project (\S+?):")
+_gradle_task_pattern = re.compile(r"> Task ((?::[^:\s]+)*):[^:\s]+")
+
+# Errors, (file, line, column, message).
+_error_patterns = [
+    # Maven's javac output: `/src/Foo.java:[12,8] cannot find symbol`.
+    re.compile(r"(.+\.java):\[(\d+),(\d+)\] (.*)"),
+    # Plain javac, as printed by Gradle: `/src/Foo.java:12: error: cannot find symbol`.
+    re.compile(r"(.+\.java):(\d+)(): error: (.*)"),
+    # Kotlin: `e: file:///src/Foo.kt:12:5 Unresolved reference: Bar`.
+    re.compile(r"e: (?:file://)?(.+\.kts?):(\d+):(\d+) (.*)"),
+    # Older Kotlin: `e: /src/Foo.kt: (12, 5): Unresolved reference: Bar`.
+    re.compile(r"e: (.+\.kts?): \((\d+), (\d+)\): (.*)"),
+]
+
+
+class JVM(FrontEnd):
+    """
+    Maven and Gradle logs, with tool decoration stripped and duplicated summaries removed.
+    """
+
+    @staticmethod
+    def matches(command: List[str]) -> bool:
+        return executable(command) in ["mvn", "mvnw", "gradle", "gradlew"]
+
+    def prepare(self, command: List[str]) -> List[str]:
+        command = list(command)
+        name = executable(command)
+        if name in ["mvn", "mvnw"]:
+            # Batch mode drops colors and download progress.
+            if "-B" not in command and "--batch-mode" not in command:
+                command.append("--batch-mode")
+        elif not any(argument.startswith("--console") for argument in command):
+            command.append("--console=plain")
+        return command
+
+    def parse(self, stdout: str, stderr: str) -> List[ErrorRecord]:
+        records: List[ErrorRecord] = []
+        seen: Dict[Tuple[str, int, Optional[int], str], ErrorRecord] = {}
+        module: Optional[str] = None
+        current: Optional[ErrorRecord] = None
+
+        for line in preprocess.lines(stdout + "\n" + stderr):
+            line = line.rstrip()
+            level = None
+            match = _level_pattern.match(line)
+            if match:
+                level, line = match.group(1), match.group(2)
+
+            # Module attribution.
+            for pattern in [
+                _maven_building_pattern,
+                _maven_plugin_pattern,
+                _maven_summary_pattern,
+                _gradle_task_pattern,
+            ]:
+                match = pattern.match(line)
+                if match:
+                    module = match.group(1)
+                    if pattern is _gradle_task_pattern:
+                        module = module.strip(":") or "(root)"
+                    current = None
+                    break
+            if match:
+                continue
+
+            if level in ["WARNING", "INFO", "DEBUG"]:
+                current = None
+                continue
+
+            for pattern in _error_patterns:
+                match = pattern.match(line.strip())
+                if match:
+                    break
+            if match:
+                file, line_number, column, message = match.groups()
+                key = (
+                    file,
+                    int(line_number),
+                    int(column) if column else None,
+                    message.strip(),
+                )
+                if key in seen:
+                    # The summary at the end of a Maven build repeats every error.
+                    current = None
+                    if not seen[key].group:
+                        seen[key].group = module
+                    continue
+                current = ErrorRecord(
+                    file=key[0],
+                    line=key[1],
+                    column=key[2],
+                    message=key[3],
+                    group=module,
+                )
+                seen[key] = current
+                records.append(current)
+            elif current and line.startswith(" "):
+                # Skip the caret under the source line, it does not survive reformatting.
+                if line.strip() != "^":
+                    current.details.append(line)
+            else:
+                current = None
+        return records
+
+    def key(self, record: ErrorRecord) -> str:
+        # javac messages such as "cannot find symbol" are generic, the symbol is in
+        # the details that follow.
+        symbols = [d.strip() for d in record.details if d.strip().startswith("symbol")]
+        return " ".join([f"[{record.group or '?'}]", record.message, *symbols[:1]])
@@ -0,0 +1,190 @@
+import argparse
+import os
+import re
+from typing import IO, Iterator, List, Optional
+
+from .records import ErrorRecord, FrontEnd, executable, executable_index
+
+# TeX engines wrap log lines at max_print_line, 79 characters by default.
+_MAX_PRINT_LINE = 79
+
+_engines = [
+    "latex",
+    "pdflatex",
+    "xelatex",
+    "lualatex",
+    "latexmk",
+    "platex",
+    "uplatex",
+]
+
+_file_line_error_pattern = re.compile(r"(.*\.(?:tex|sty|cls|bib|ltx)):(\d+): (.*)")
+_context_pattern = re.compile(r"l\.(\d+) ?(.*)")
+_undefined_pattern = re.compile(
+    r".*Warning: (Reference|Citation) [`'](.*)' on page \S+ undefined"
+    r" on input line (\d+)\."
+)
+# Opened files look like `(./chapters/intro.tex` or `(/usr/share/.../article.cls`.
+_open_file_pattern = re.compile(r'\(("[^"]+"|[^\s()\[\]{}]+)')
+
+
+def _option(command: List[str], names: List[str]) -> Optional[str]:
+    """
+    Returns the value of `-name=value` or `-name value`, accepting `--name` too.
+    """
+    for i, argument in enumerate(command):
+        stripped = argument.lstrip("-")
+        if argument == stripped:
+            continue
+        for name in names:
+            if stripped.startswith(name + "="):
+                return stripped[len(name) + 1 :]
+            if stripped == name and i + 1 < len(command):
+                return command[i + 1]
+    return None
+
+
+def unwrap(stream: IO[str]) -> Iterator[str]:
+    """
+    Yields logical lines, joining the physical lines TeX broke at max_print_line.
+    """
+    pending = ""
+    for line in stream:
+        line = line.rstrip("\r\n")
+        pending += line
+        # Engines count bytes rather than characters, so check both.
+        if _MAX_PRINT_LINE in [len(line), len(line.encode("utf-8"))]:
+            continue
+        yield pending
+        pending = ""
+    if pending:
+        yield pending
+
+
+class LaTeX(FrontEnd):
+    """
+    Reads the .log file written by the engine rather than the terminal output.
+    """
+
+    def __init__(self, args: argparse.Namespace):
+        super().__init__(args)
+        # Modification time of the log before the run, see parse().
+        self.previous_log: Optional[int] = None
+
+    @staticmethod
+    def matches(command: List[str]) -> bool:
+        return executable(command) in _engines
+
+    def prepare(self, command: List[str]) -> List[str]:
+        command = list(command)
+        # Without this, the engine stops and waits for user input on the first error.
+        if _option(command, ["interaction"]) is None:
+            index = executable_index(command) or 0
+            command.insert(index + 1, "-interaction=nonstopmode")
+        self.previous_log = self._log_mtime()
+        return command
+
+    def log_path(self) -> Optional[str]:
+        command = self.args.command
+        jobname = _option(command, ["jobname"])
+        if not jobname:
+            index = executable_index(command) or 0
+            sources = [a for a in command[index + 1 :] if not a.startswith("-")]
+            if not sources:
+                return None
+            jobname = os.path.splitext(os.path.basename(sources[-1]))[0]
+        directory = _option(command, ["output-directory", "outdir"]) or "."
+        return os.path.join(directory, f"{jobname}.log")
+
+    def _log_mtime(self) -> Optional[int]:
+        path = self.log_path()
+        try:
+            return os.stat(path).st_mtime_ns if path else None
+        except OSError:
+            return None
+
+    def parse(self, stdout: str, stderr: str) -> List[ErrorRecord]:
+        path = self.log_path()
+        mtime = self._log_mtime()
+        # The engine can fail before writing a log, for example on a missing
+        # source, and the one left by an earlier build describes other errors.
+        if not path or mtime is None or mtime == self.previous_log:
+            return []
+        with open(path, "r", encoding="utf-8", errors="replace") as f:
+            return self.parse_log(f)
+
+    def parse_log(self, stream: IO[str]) -> List[ErrorRecord]:
+        records: List[ErrorRecord] = []
+        # Files opened by the engine. Non-file parentheses are kept as None so that
+        # closing parentheses stay balanced.
+        stack: List[Optional[str]] = []
+        # An error waiting for the `l.<number>` line that gives its location.
+        pending: Optional[ErrorRecord] = None
+
+        def current_file() -> Optional[str]:
+            for entry in reversed(stack):
+                if entry:
+                    return entry
+            return None
+
+        for line in unwrap(stream):
+            if pending:
+                match = _context_pattern.match(line)
+                if match:
+                    pending.line = int(match.group(1))
+                    pending.details.append(line)
+                    pending = None
+                elif line.strip():
+                    pending.details.append(line)
+                    if len(pending.details) > 8:
+                        pending = None
+                continue
+
+            if line.startswith("! "):
+                pending = ErrorRecord(file=current_file(), message=line[2:])
+                records.append(pending)
+                continue
+
+            match = _file_line_error_pattern.match(line)
+            if match:
+                pending = ErrorRecord(
+                    file=match.group(1),
+                    line=int(match.group(2)),
+                    message=match.group(3),
+                )
+                records.append(pending)
+                continue
+
+            match = _undefined_pattern.match(line)
+            if match:
+                records.append(
+                    ErrorRecord(
+                        file=current_file(),
+                        line=int(match.group(3)),
+                        code=f"undefined {match.group(1).lower()}",
+                        message=f"{match.group(1)} `{match.group(2)}' undefined",
+                    )
+                )
+                continue
+
+            # Track the file stack from parentheses.
+            i = 0
+            while i < len(line):
+                if line[i] == "(":
+                    match = _open_file_pattern.match(line, i)
+                    name = match.group(1).strip('"') if match else None
+                    if name and ("." in os.path.basename(name) or "/" in name):
+                        stack.append(name)
+                        i = match.end() if match else i + 1
+                        continue
+                    stack.append(None)
+                elif line[i] == ")" and stack:
+                    stack.pop()
+                i += 1
+        return records
+
+    def key(self, record: ErrorRecord) -> str:
+        # All undefined references are usually fixed together (rerun, missing .bib).
+        if record.code:
+            return record.code
+        return record.message
@@ -0,0 +1,291 @@
+import argparse
+import importlib.util
+import json
+import os
+import re
+import sysconfig
+import tempfile
+from typing import Any, Dict, List, Optional, Tuple
+
+from .records import ErrorRecord, FrontEnd, executable, executable_index
+
+_frame_pattern = re.compile(r'\s*File "(.*?)", line (\d+)(?:, in (.*))?')
+_chain_separators = [
+    "During handling of the above exception, another exception occurred:",
+    "The above exception was the direct cause of the following exception:",
+]
+# Python 3.11+ underlines the failing expression with ^ and ~.
+_marker_pattern = re.compile(r"\s*[\^~]+\s*$")
+# pytest's terminal output, used when the report-log plugin is not available.
+_pytest_section_pattern = re.compile(r"_{3,} (.+?) _{3,}$")
+# `test_x.py:12: AssertionError` ends a failure, `test_x.py:8: in helper` lines are
+# the frames leading to it.
+_pytest_crash_pattern = re.compile(r"(.+?\.py):(\d+): ([\w.]+)$")
+_pytest_frame_pattern = re.compile(r"(.+?\.py):(\d+): in ")
+
+_library_paths = [
+    sysconfig.get_paths()[name] for name in ["stdlib", "purelib", "platlib"]
+]
+
+
+def _is_library(path: str) -> bool:
+    return (
+        "site-packages" in path
+        or "dist-packages" in path
+        or path.startswith("<frozen ")
+        or any(path.startswith(library) for library in _library_paths)
+    )
+
+
+# (file, line, function, source lines)
+_Frame = Tuple[str, int, Optional[str], List[str]]
+
+
+def _fold(frames: List[_Frame]) -> List[str]:
+    """
+    Format frames as a traceback, replacing runs of library frames with a count.
+    The innermost frame is always kept since that is where the exception was raised.
+    """
+    result: List[str] = []
+    folded = 0
+    for i, (file, line, function, source) in enumerate(frames):
+        if _is_library(file) and i != len(frames) - 1:
+            folded += 1
+            continue
+        if folded:
+            result.append(f"  [... {folded} library frames ...]")
+            folded = 0
+        result.append(f'  File "{file}", line {line}, in {function or "?"}')
+        result.extend(f"    {s}" for s in source)
+    return result
+
+
+class Python(FrontEnd):
+    """
+    Python tracebacks, with exception chains folded into a single record, and pytest
+    failures, deduplicated across parametrized tests.
+    """
+
+    def __init__(self, args: argparse.Namespace):
+        super().__init__(args)
+        # The report log created by prepare(), rather than one the user asked for.
+        self.temporary: Optional[str] = None
+
+    @staticmethod
+    def matches(command: List[str]) -> bool:
+        name = executable(command) or ""
+        return re.match(r"(python[\d.]*|pytest|py\.test)$", name) is not None
+
+    def pytest(self, command: List[str]) -> bool:
+        index = executable_index(command) or 0
+        name = executable(command)
+        return name in ["pytest", "py.test"] or command[index + 1 : index + 3] == [
+            "-m",
+            "pytest",
+        ]
+
+    def prepare(self, command: List[str]) -> List[str]:
+        if not self.pytest(command):
+            return command
+        if any(argument.startswith("--report-log") for argument in command):
+            return command
+        # The plugin must be installed where the tests run, assume it is the same
+        # environment as ours.
+        if importlib.util.find_spec("pytest_reportlog") is None:
+            return command
+        handle, self.temporary = tempfile.mkstemp(prefix="cwhy-", suffix=".jsonl")
+        os.close(handle)
+        return [*command, f"--report-log={self.temporary}"]
+
+    def cleanup(self) -> None:
+        if self.temporary and os.path.exists(self.temporary):
+            os.remove(self.temporary)
+
+    def parse(self, stdout: str, stderr: str) -> List[ErrorRecord]:
+        if self.pytest(self.args.command):
+            for argument in self.args.command:
+                if argument.startswith("--report-log="):
+                    path = argument[len("--report-log=") :]
+                    if os.path.isfile(path) and os.path.getsize(path) > 0:
+                        with open(path, "r") as f:
+                            return self.parse_report_log(f.read())
+            return self.parse_pytest(stdout)
+        return self.parse_tracebacks(stderr)
+
+    def parse_tracebacks(self, output: str) -> List[ErrorRecord]:
+        records: List[ErrorRecord] = []
+        # Each chain is a list of (separator, frames, exception lines).
+        chains: List[List[Tuple[str, List[_Frame], List[str]]]] = []
+        frames: Optional[List[_Frame]] = None
+        exception: List[str] = []
+        separator = ""
+
+        for line in output.splitlines():
+            match = _frame_pattern.match(line)
+            if line.startswith("Traceback (most recent call last):") or (
+                match and frames is None
+            ):
+                if not separator or not chains:
+                    chains.append([])
+                frames = []
+                exception = []
+                chains[-1].append((separator, frames, exception))
+                separator = ""
+                if not match:
+                    continue
+
+            if frames is None:
+                if line.strip() in _chain_separators:
+                    separator = line.strip()
+                continue
+
+            if match and not exception:
+                frames.append((match.group(1), int(match.group(2)), match.group(3), []))
+            elif line.startswith("    ") and not exception and frames:
+                if not _marker_pattern.match(line):
+                    frames[-1][3].append(line.strip())
+            elif line.strip() and not _marker_pattern.match(line):
+                exception.append(line.strip())
+                if not line.startswith(" "):
+                    # The exception line itself ends this traceback.
+                    frames = None
+
+        for chain in chains:
+            details: List[str] = []
+            for chain_separator, chain_frames, chain_exception in chain:
+                if chain_separator:
+                    details.extend(["", chain_separator, ""])
+                details.extend(_fold(chain_frames))
+                details.extend(chain_exception)
+            _, last_frames, last_exception = chain[-1]
+            record = ErrorRecord(
+                message=last_exception[-1] if last_exception else "exception",
+                details=details,
+            )
+            # Point at the innermost frame in user code.
+            for file, line_number, _, _ in reversed(last_frames):
+                if not _is_library(file):
+                    record.file, record.line = file, line_number
+                    break
+            records.append(record)
+        return records
+
+    def parse_report_log(self, log: str) -> List[ErrorRecord]:
+        records: List[ErrorRecord] = []
+        for line in log.splitlines():
+            try:
+                report = json.loads(line)
+            except json.JSONDecodeError:
+                # Blank, or cut short by Ctrl-C or a crashed xdist worker.
+                continue
+            if not isinstance(report, dict):
+                continue
+            if report.get("outcome") != "failed":
+                continue
+            nodeid = report.get("nodeid", "")
+            longrepr = report.get("longrepr")
+            if not isinstance(longrepr, dict):
+                records.append(
+                    ErrorRecord(
+                        message=(
+                            str(longrepr).strip().splitlines()[-1]
+                            if longrepr
+                            else "failed"
+                        ),
+                        code=nodeid,
+                    )
+                )
+                continue
+
+            chain = longrepr.get("chain") or [
+                [longrepr.get("reprtraceback"), longrepr.get("reprcrash"), None]
+            ]
+            details: List[str] = []
+            for traceback, _, description in chain:
+                details.extend(self.format_entries(traceback or {}))
+                if description:
+                    details.append(description)
+            crash: Dict[str, Any] = longrepr.get("reprcrash") or {}
+            records.append(
+                ErrorRecord(
+                    file=crash.get("path"),
+                    line=crash.get("lineno"),
+                    message=(crash.get("message") or "failed").splitlines()[0],
+                    code=nodeid,
+                    group=nodeid.split("::")[0],
+                    details=details,
+                )
+            )
+        return records
+
+    @staticmethod
+    def format_entries(traceback: Dict[str, Any]) -> List[str]:
+        result: List[str] = []
+        folded = 0
+        for entry in traceback.get("reprentries", []):
+            data = entry.get("data", {})
+            location = data.get("reprfileloc") or {}
+            if _is_library(location.get("path", "")):
+                folded += 1
+                continue
+            if folded:
+                result.append(f"[... {folded} library frames ...]")
+                folded = 0
+            # Keep the failing source line (>) and the error lines (E).
+            result.extend(
+                line for line in data.get("lines", []) if line.startswith((">", "E"))
+            )
+            if location:
+                result.append(
+                    f"{location.get('path')}:{location.get('lineno')}: "
+                    f"{location.get('message')}"
+                )
+        return result
+
+    def parse_pytest(self, output: str) -> List[ErrorRecord]:
+        records: List[ErrorRecord] = []
+        current: Optional[ErrorRecord] = None
+        # Innermost frame of each failure, for --tb=short, which has no crash line.
+        innermost: Dict[int, Tuple[str, int]] = {}
+        for line in output.splitlines():
+            match = _pytest_section_pattern.match(line)
+            if match:
+                current = ErrorRecord(message="failed", code=match.group(1))
+                records.append(current)
+                continue
+            if line.startswith("=") or current is None:
+                # End of the failures section.
+                current = None
+                continue
+            if line.startswith("E "):
+                if current.message == "failed":
+                    current.message = line[1:].strip()
+                current.details.append(line)
+            elif line.startswith(">"):
+                current.details.append(line)
+            else:
+                match = _pytest_crash_pattern.match(line)
+                if match:
+                    current.file = match.group(1)
+                    current.line = int(match.group(2))
+                    current.details.append(line)
+                    # Prefix with the exception type, as in the report log, unless
+                    # it is already there, maybe qualified by its module.
+                    if not current.message.split(":")[0].endswith(match.group(3)):
+                        current.message = f"{match.group(3)}: {current.message}"
+                    continue
+                match = _pytest_frame_pattern.match(line)
+                if match:
+                    current.details.append(line)
+                    innermost[len(records) - 1] = (match.group(1), int(match.group(2)))
+        for index, (file, line_number) in innermost.items():
+            if not records[index].file:
+                records[index].file = file
+                records[index].line = line_number
+        return [record for record in records if record.file or record.details]
+
+    def key(self, record: ErrorRecord) -> str:
+        # Parametrized tests failing the same way share the crash location and the
+        # exception type, while messages often embed the parameters.
+        exception = record.message.split(":")[0]
+        return f"{record.location()}: {exception}"
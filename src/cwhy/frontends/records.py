@@ -0,0 +1,207 @@
+import argparse
+import collections
+import dataclasses
+import hashlib
+import os
+import re
+from typing import Callable, Dict, List, Optional, Tuple
+
+
+@dataclasses.dataclass
+class ErrorRecord:
+    """
+    A single diagnostic extracted from a tool's output by a front end.
+    """
+
+    message: str
+    file: Optional[str] = None
+    line: Optional[int] = None
+    column: Optional[int] = None
+    # End of the span, when the tool reports one.
+    end_line: Optional[int] = None
+    end_column: Optional[int] = None
+    # Tool-specific error code, for example TS2322 or CS1010.
+    code: Optional[str] = None
+    # The module, package, or project the error was reported for.
+    group: Optional[str] = None
+    # Additional lines following the first one (notes, elaborations, ...).
+    details: List[str] = dataclasses.field(default_factory=list)
+
+    def location(self) -> str:
+        result = self.file or ""
+        if self.line is not None:
+            result += f":{self.line}"
+            if self.column is not None:
+                result += f":{self.column}"
+        return result
+
+    def format(self) -> str:
+        """
+        Format as `file:line:column: error CODE: message`, followed by any details.
+        """
+        header = "error"
+        if self.code:
+            header += f" {self.code}"
+        result = f"{header}: {self.message}"
+        if self.file:
+            result = f"{self.location()}: {result}"
+        if self.group:
+            result = f"[{self.group}] {result}"
+        return "\n".join([result, *self.details])
+
+
+@dataclasses.dataclass
+class ErrorCluster:
+    """
+    A group of records sharing the same root cause, explained once.
+    """
+
+    key: str
+    records: List[ErrorRecord]
+
+    def representatives(self, n: int = 3) -> List[ErrorRecord]:
+        """
+        Pick up to n records, preferring ones from different files.
+        """
+        chosen: List[int] = []
+        files = set()
+        for i, record in enumerate(self.records):
+            if len(chosen) < n and record.file not in files:
+                files.add(record.file)
+                chosen.append(i)
+        for i in range(len(self.records)):
+            if len(chosen) < n and i not in chosen:
+                chosen.append(i)
+        return [self.records[i] for i in sorted(chosen)]
+
+    def diagnostic(self, n: int = 3) -> str:
+        examples = self.representatives(n)
+        lines = [record.format() for record in examples]
+        remaining = len(self.records) - len(examples)
+        if remaining > 0:
+            lines.append(f"[... {remaining} more occurrences of this error ...]")
+        return "\n".join(lines)
+
+    def locations(self, n: int = 3) -> List[Tuple[str, int]]:
+        result = []
+        for record in self.representatives(n):
+            if record.file and record.line:
+                result.append((record.file, record.line))
+        return result
+
+    def fingerprint(self) -> str:
+        primary = self.records[0]
+        return fingerprint(primary.code, primary.message)
+
+
+_location_prefix_pattern = re.compile(r"^\s*\S+?:\d+(?::\d+)?:\s*")
+_path_pattern = re.compile(r"[\w.~-]*[/\\][\w./\\~-]*")
+_number_pattern = re.compile(r"\b\d+\b")
+
+
+def fingerprint(code: Optional[str], message: str) -> str:
+    """
+    Identifies the root cause of an error across builds and machines, ignoring the
+    location, paths, and numbers in the message.
+    """
+    message = _location_prefix_pattern.sub("", message, count=1)
+    message = _path_pattern.sub("<path>", message)
+    message = _number_pattern.sub("N", message)
+    normalized = " ".join([code or "", *message.split()])
+    return hashlib.sha256(normalized.encode()).hexdigest()[:16]
+
+
+def cluster_records(
+    records: List[ErrorRecord], key: Callable[[ErrorRecord], str]
+) -> List[ErrorCluster]:
+    """
+    Group records by key, largest clusters first, ties broken by first appearance.
+    """
+    groups: Dict[str, List[ErrorRecord]] = collections.OrderedDict()
+    for record in records:
+        groups.setdefault(key(record), []).append(record)
+    clusters = [ErrorCluster(k, v) for k, v in groups.items()]
+    # sorted() is stable, so first appearance order is kept among equal sizes.
+    return sorted(clusters, key=lambda c: -len(c.records))
+
+
+def _program_name(argument: str) -> str:
+    name, extension = os.path.splitext(os.path.basename(argument))
+    if extension.lower() not in ["", ".exe", ".cmd", ".bat"]:
+        name += extension
+    return name
+
+
+def executable_index(command: List[str]) -> Optional[int]:
+    """
+    Returns the position of the wrapped program, skipping launchers such as npx.
+    """
+    launchers = {"env", "exec", "npx", "pnpm", "yarn", "bunx"}
+    for i, argument in enumerate(command):
+        if _program_name(argument) in launchers or "=" in argument:
+            continue
+        return i
+    return None
+
+
+def executable(command: List[str]) -> Optional[str]:
+    """
+    Returns the name of the wrapped program, for example `tsc` for `npx tsc -b`.
+    """
+    index = executable_index(command)
+    return _program_name(command[index]) if index is not None else None
+
+
+class FrontEnd:
+    """
+    Base class for tools whose output deserves more than line-by-line regex matching.
+    """
+
+    def __init__(self, args: argparse.Namespace):
+        self.args = args
+
+    @staticmethod
+    def matches(command: List[str]) -> bool:
+        raise NotImplementedError
+
+    def prepare(self, command: List[str]) -> List[str]:
+        """
+        Returns the command to run, possibly requesting more structured output.
+        """
+        return command
+
+    def returncode(self, returncode: int, stdout: str, stderr: str) -> int:
+        """
+        Returns whether the command failed, for tools whose structured output mode
+        changes their exit status.
+        """
+        return returncode
+
+    def has_findings(self, stdout: str, stderr: str) -> bool:
+        """
+        Returns whether there is something to explain although the command
+        succeeded. Unlike returncode(), this does not change the exit status.
+        """
+        return False
+
+    def cleanup(self) -> None:
+        """
+        Removes the temporary files prepare() created, whether or not the command
+        failed.
+        """
+
+    def display(self, stdout: str, stderr: str) -> Tuple[str, str]:
+        """
+        Returns the output to show, readable again when prepare() requested a
+        structured format.
+        """
+        return (stdout, stderr)
+
+    def parse(self, stdout: str, stderr: str) -> List[ErrorRecord]:
+        raise NotImplementedError
+
+    def key(self, record: ErrorRecord) -> str:
+        return f"{record.code or 'error'}: {record.message}"
+
+    def clusters(self, stdout: str, stderr: str) -> List[ErrorCluster]:
+        return cluster_records(self.parse(stdout, stderr), self.key)
@@ -0,0 +1,213 @@
+"""
+Reader for clang-style serialized diagnostics (.dia files), as written by swiftc
+-serialize-diagnostics-path and clang --serialize-diagnostics.
+
+The file is an LLVM bitstream: https://llvm.org/docs/BitCodeFormat.html. Only the
+parts needed by the diagnostics format are implemented.
+"""
+
+import dataclasses
+from typing import BinaryIO, Dict, Iterator, List, Optional, Tuple
+
+_MAGIC = b"DIAG"
+
+# Builtin abbreviation IDs.
+_END_BLOCK = 0
+_ENTER_SUBBLOCK = 1
+_DEFINE_ABBREV = 2
+_UNABBREV_RECORD = 3
+
+# Abbreviation operand encodings.
+_FIXED = 1
+_VBR = 2
+_ARRAY = 3
+_CHAR6 = 4
+_BLOB = 5
+
+_BLOCKINFO_BLOCK = 0
+_SETBID = 1
+
+# From clang/Frontend/SerializedDiagnostics.h.
+_BLOCK_DIAG = 9
+_RECORD_DIAG = 2
+_RECORD_FILENAME = 6
+
+SEVERITIES = ["ignored", "note", "warning", "error", "fatal", "remark"]
+
+_CHAR6_ALPHABET = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789._"
+
+# An operand is (literal value or None, encoding, encoding width).
+_Operand = Tuple[Optional[int], int, int]
+
+
+@dataclasses.dataclass
+class Diagnostic:
+    severity: str
+    file: Optional[str]
+    line: int
+    column: int
+    message: str
+    notes: List["Diagnostic"] = dataclasses.field(default_factory=list)
+
+
+class _BitReader:
+    def __init__(self, data: bytes):
+        self.data = data
+        self.position = 0
+
+    def at_end(self) -> bool:
+        return self.position >= len(self.data) * 8
+
+    def read(self, width: int) -> int:
+        start = self.position >> 3
+        end = (self.position + width + 7) >> 3
+        value = int.from_bytes(self.data[start:end], "little") >> (self.position & 7)
+        self.position += width
+        return value & ((1 << width) - 1)
+
+    def read_vbr(self, width: int) -> int:
+        result = 0
+        shift = 0
+        high = 1 << (width - 1)
+        while True:
+            chunk = self.read(width)
+            result |= (chunk & (high - 1)) << shift
+            if not chunk & high:
+                return result
+            shift += width - 1
+
+    def align32(self) -> None:
+        self.position = (self.position + 31) & ~31
+
+
+def _read_abbrev(reader: _BitReader) -> List[_Operand]:
+    operands: List[_Operand] = []
+    for _ in range(reader.read_vbr(5)):
+        if reader.read(1):
+            operands.append((reader.read_vbr(8), 0, 0))
+            continue
+        encoding = reader.read(3)
+        width = reader.read_vbr(5) if encoding in [_FIXED, _VBR] else 0
+        operands.append((None, encoding, width))
+    return operands
+
+
+def _read_scalar(reader: _BitReader, operand: _Operand) -> int:
+    literal, encoding, width = operand
+    if literal is not None:
+        return literal
+    if encoding == _FIXED:
+        return reader.read(width)
+    if encoding == _VBR:
+        return reader.read_vbr(width)
+    if encoding == _CHAR6:
+        return ord(_CHAR6_ALPHABET[reader.read(6)])
+    raise ValueError(f"unexpected operand encoding {encoding}")
+
+
+def _read_record(
+    reader: _BitReader, abbrev: List[_Operand]
+) -> Tuple[int, List[int], bytes]:
+    values: List[int] = []
+    blob = b""
+    i = 0
+    while i < len(abbrev):
+        _, encoding, _ = abbrev[i]
+        if encoding == _ARRAY:
+            # The element encoding is the next (and last) operand.
+            element = abbrev[i + 1]
+            length = reader.read_vbr(6)
+            values.extend(_read_scalar(reader, element) for _ in range(length))
+            i += 2
+        elif encoding == _BLOB:
+            length = reader.read_vbr(6)
+            reader.align32()
+            start = reader.position >> 3
+            blob = reader.data[start : start + length]
+            reader.position += length * 8
+            reader.align32()
+            i += 1
+        else:
+            values.append(_read_scalar(reader, abbrev[i]))
+            i += 1
+    return values[0], values[1:], blob
+
+
+def _records(data: bytes) -> Iterator[Tuple[int, int, List[int], bytes]]:
+    """
+    Yields (depth, code, operands, blob) for each record in a diagnostics block,
+    where depth is the nesting level of the diagnostic block the record belongs to.
+    """
+    reader = _BitReader(data)
+    if reader.read(32) != int.from_bytes(_MAGIC, "little"):
+        raise ValueError("not a serialized diagnostics file")
+
+    # Abbreviations registered through BLOCKINFO, per block ID.
+    blockinfo: Dict[int, List[List[_Operand]]] = {}
+    # Stack of (block ID, abbreviation width, abbreviations).
+    stack: List[Tuple[int, int, List[List[_Operand]]]] = [(-1, 2, [])]
+    current_blockinfo_target: Optional[int] = None
+
+    while not reader.at_end():
+        block_id, width, abbrevs = stack[-1]
+        abbrev_id = reader.read(width)
+        if abbrev_id == _END_BLOCK:
+            reader.align32()
+            if len(stack) == 1:
+                return
+            stack.pop()
+        elif abbrev_id == _ENTER_SUBBLOCK:
+            new_block_id = reader.read_vbr(8)
+            new_width = reader.read_vbr(4)
+            reader.align32()
+            reader.read(32)  # Block length in words.
+            stack.append(
+                (new_block_id, new_width, list(blockinfo.get(new_block_id, [])))
+            )
+        elif abbrev_id == _DEFINE_ABBREV:
+            abbrev = _read_abbrev(reader)
+            if block_id == _BLOCKINFO_BLOCK and current_blockinfo_target is not None:
+                blockinfo.setdefault(current_blockinfo_target, []).append(abbrev)
+            else:
+                abbrevs.append(abbrev)
+        else:
+            if abbrev_id == _UNABBREV_RECORD:
+                code = reader.read_vbr(6)
+                operands = [reader.read_vbr(6) for _ in range(reader.read_vbr(6))]
+                blob = b""
+            else:
+                code, operands, blob = _read_record(reader, abbrevs[abbrev_id - 4])
+
+            if block_id == _BLOCKINFO_BLOCK:
+                if code == _SETBID:
+                    current_blockinfo_target = operands[0]
+            elif block_id == _BLOCK_DIAG:
+                depth = sum(1 for b, _, _ in stack if b == _BLOCK_DIAG)
+                yield depth, code, operands, blob
+
+
+def read(stream: BinaryIO) -> List[Diagnostic]:
+    """
+    Returns top-level diagnostics, with their notes attached.
+    """
+    files: Dict[int, str] = {}
+    diagnostics: List[Diagnostic] = []
+    for depth, code, operands, blob in _records(stream.read()):
+        if code == _RECORD_FILENAME:
+            name = blob or bytes(operands[4:])
+            files[operands[0]] = name.decode("utf-8", errors="replace")
+        elif code == _RECORD_DIAG:
+            severity, file_id, line, column = operands[:4]
+            message = blob or bytes(operands[8:])
+            diagnostic = Diagnostic(
+                severity=SEVERITIES[severity] if severity < len(SEVERITIES) else "?",
+                file=files.get(file_id),
+                line=line,
+                column=column,
+                message=message.decode("utf-8", errors="replace"),
+            )
+            if depth > 1 and diagnostics:
+                diagnostics[-1].notes.append(diagnostic)
+            else:
+                diagnostics.append(diagnostic)
+    return diagnostics
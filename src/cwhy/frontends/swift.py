@@ -0,0 +1,100 @@
+import argparse
+import os
+import re
+import tempfile
+from typing import List, Optional
+
+from . import serialized_diagnostics
+from .records import ErrorRecord, FrontEnd, executable
+
+_error_pattern = re.compile(r"(.+?\.swift):(\d+):(\d+): (error|note): (.*)")
+_single_job_flags = ["-wmo", "-whole-module-optimization", "-frontend"]
+
+
+def _diagnostics_path(command: List[str]) -> Optional[str]:
+    for i, argument in enumerate(command[:-1]):
+        if argument != "-serialize-diagnostics-path":
+            continue
+        if command[i + 1] != "-Xfrontend":
+            return command[i + 1]
+        # Passed to the frontend job as `-Xfrontend -serialize-diagnostics-path
+        # -Xfrontend path`.
+        if i + 2 < len(command):
+            return command[i + 2]
+    return None
+
+
+class Swift(FrontEnd):
+    """
+    Reads swiftc's serialized diagnostics rather than its multi-line text output.
+    """
+
+    def __init__(self, args: argparse.Namespace):
+        super().__init__(args)
+        # The diagnostics file created by prepare(), rather than one the user asked for.
+        self.temporary: Optional[str] = None
+
+    @staticmethod
+    def matches(command: List[str]) -> bool:
+        return executable(command) == "swiftc"
+
+    def prepare(self, command: List[str]) -> List[str]:
+        if _diagnostics_path(command):
+            return command
+        # The path is given to every frontend job, so it can only be used when the
+        # driver schedules a single one.
+        inputs = [argument for argument in command if argument.endswith(".swift")]
+        if len(inputs) != 1 and not any(f in command for f in _single_job_flags):
+            return command
+        handle, path = tempfile.mkstemp(prefix="cwhy-", suffix=".dia")
+        os.close(handle)
+        self.temporary = path
+        return [
+            *command,
+            *["-Xfrontend", "-serialize-diagnostics-path", "-Xfrontend", path],
+        ]
+
+    def cleanup(self) -> None:
+        if self.temporary and os.path.exists(self.temporary):
+            os.remove(self.temporary)
+
+    def parse(self, stdout: str, stderr: str) -> List[ErrorRecord]:
+        path = _diagnostics_path(self.args.command)
+        if path and os.path.isfile(path) and os.path.getsize(path) > 0:
+            with open(path, "rb") as f:
+                diagnostics = serialized_diagnostics.read(f)
+            return [
+                ErrorRecord(
+                    file=diagnostic.file,
+                    line=diagnostic.line,
+                    column=diagnostic.column,
+                    message=diagnostic.message,
+                    details=[
+                        f"{note.file}:{note.line}:{note.column}: note: {note.message}"
+                        for note in diagnostic.notes
+                    ],
+                )
+                for diagnostic in diagnostics
+                if diagnostic.severity in ["error", "fatal"]
+            ]
+
+        # Only keep the `file:line:column: error:` headers, not the source excerpts
+        # that follow them: the code is sent separately.
+        records: List[ErrorRecord] = []
+        for line in stderr.splitlines():
+            match = _error_pattern.match(line)
+            if not match:
+                continue
+            if match.group(4) == "note":
+                if records:
+                    records[-1].details.append(line)
+                continue
+            records.append(
+                ErrorRecord(
+                    file=match.group(1),
+                    line=int(match.group(2)),
+                    column=int(match.group(3)),
+                    message=match.group(5),
+                )
+            )
+        return records
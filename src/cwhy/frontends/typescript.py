@@ -0,0 +1,98 @@
+import hashlib
+import os
+import re
+import tempfile
+from typing import List, Optional
+
+from .records import ErrorRecord, FrontEnd, executable
+
+# Plain format: `src/a.ts(12,5): error TS2322: message`.
+# Pretty format: `src/a.ts:12:5 - error TS2322: message`.
+_located_patterns = [
+    re.compile(r"(.+?)\((\d+),(\d+)\): error (TS\d+): (.*)"),
+    re.compile(r"(.+?):(\d+):(\d+) - error (TS\d+): (.*)"),
+]
+# Global errors, for example a missing or invalid tsconfig.json.
+_global_pattern = re.compile(r"error (TS\d+): (.*)")
+# Printed by `tsc --build --verbose` before each project is checked.
+_project_pattern = re.compile(r".*Building project '(.*)'\.\.\.")
+_quoted_pattern = re.compile(r"'([^']+)'")
+
+
+class TypeScript(FrontEnd):
+    @staticmethod
+    def matches(command: List[str]) -> bool:
+        return executable(command) == "tsc"
+
+    def prepare(self, command: List[str]) -> List[str]:
+        command = list(command)
+        if "--pretty" not in command:
+            command += ["--pretty", "false"]
+
+        # In diff-converse, the code is recompiled after every modification. Let tsc
+        # keep a .tsbuildinfo file so that only affected projects are re-checked.
+        # Build mode (-b) always maintains .tsbuildinfo files for its projects.
+        building = "--build" in command or "-b" in command
+        if self.args.subcommand == "diff-converse" and not building:
+            if "--incremental" not in command and "-i" not in command:
+                command.append("--incremental")
+            if "--tsBuildInfoFile" not in command:
+                key = hashlib.sha256(
+                    "\0".join([os.getcwd(), *command]).encode("utf-8")
+                ).hexdigest()[:16]
+                directory = os.path.join(tempfile.gettempdir(), "cwhy", "tsbuildinfo")
+                os.makedirs(directory, exist_ok=True)
+                command += [
+                    "--tsBuildInfoFile",
+                    os.path.join(directory, f"{key}.tsbuildinfo"),
+                ]
+        return command
+
+    def parse(self, stdout: str, stderr: str) -> List[ErrorRecord]:
+        records: List[ErrorRecord] = []
+        project: Optional[str] = None
+        current: Optional[ErrorRecord] = None
+        for line in (stdout + "\n" + stderr).splitlines():
+            match = _project_pattern.match(line)
+            if match:
+                project = match.group(1)
+                current = None
+                continue
+
+            for pattern in _located_patterns:
+                match = pattern.match(line)
+                if match:
+                    current = ErrorRecord(
+                        file=match.group(1),
+                        line=int(match.group(2)),
+                        column=int(match.group(3)),
+                        code=match.group(4),
+                        message=match.group(5),
+                        group=project,
+                    )
+                    records.append(current)
+                    break
+            else:
+                match = _global_pattern.match(line)
+                if match:
+                    current = ErrorRecord(
+                        code=match.group(1), message=match.group(2), group=project
+                    )
+                    records.append(current)
+                elif current and line.startswith(" ") and line.strip():
+                    # Elaboration of the previous error, for example
+                    # "Types of property 'x' are incompatible.".
+                    current.details.append(line)
+                elif not line.strip():
+                    current = None
+        return records
+
+    def key(self, record: ErrorRecord) -> str:
+        # Errors caused by the same type change share a code and name the same
+        # symbols, e.g. "Property 'foo' does not exist on type 'Bar'". Both are
+        # kept: assigning a 'string' or an 'undefined' to a 'number' are different
+        # mistakes.
+        symbols = _quoted_pattern.findall(record.message)[:2]
+        if symbols:
+            return " ".join([record.code or "error", *(f"'{s}'" for s in symbols)])
+        return f"{record.code}: {record.message}"
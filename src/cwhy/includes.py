@@ -0,0 +1,246 @@
+"""
+Answers missing include errors locally, without a request, by looking for headers
+with a close name in the include path. The compiler's default directories are
+indexed once per toolchain and cached; directories from the command are indexed
+on each run since they change with the code. Only the default directories of C and
+C++ compilers are asked for, other commands are never run with made-up arguments.
+"""
+
+import argparse
+import hashlib
+import json
+import os
+import re
+import subprocess
+import tempfile
+import time
+from typing import Dict, List, Optional, Set, Tuple
+
+from . import cache, flags, results
+
+_not_found = re.compile(
+    r"^(?P<file>.+?):(?P<line>\d+):\d+: fatal error: "
+    r"(?:'(?P<clang>[^']+)' file not found|(?P<gcc>.+?): No such file or directory)"
+)
+
+# Bounds the time spent indexing large directories from the command.
+_max_files = 100000
+_max_suggestions = 3
+
+_header_extensions = [".h", ".hh", ".hpp", ".hxx", ".inc"]
+# Run in front of the compiler, as in `ccache g++`.
+_launchers = ["ccache", "sccache", "distcc", "icecc", "env"]
+# gcc, g++, clang, clang++, cc and c++, maybe with a target prefix or a version, as
+# in x86_64-linux-gnu-g++-12 or clang++-17.
+_compiler_pattern = re.compile(
+    r"(?:.+-)?(?:gcc|g\+\+|clang|clang\+\+|cc|c\+\+)(?:-[\d.]+)?(?:\.exe)?$"
+)
+
+
+def _edit_distance(a: str, b: str, limit: int) -> int:
+    """
+    Levenshtein distance, or limit + 1 when it is larger than limit.
+    """
+    # Each edit changes the set of characters used by at most two, a cheap bound
+    # that rules out most names.
+    if abs(len(a) - len(b)) > limit or len(set(a) ^ set(b)) > 2 * limit:
+        return limit + 1
+    previous = list(range(len(b) + 1))
+    for i, x in enumerate(a, 1):
+        current = [i]
+        for j, y in enumerate(b, 1):
+            current.append(
+                min(previous[j] + 1, current[j - 1] + 1, previous[j - 1] + (x != y))
+            )
+        if min(current) > limit:
+            return limit + 1
+        previous = current
+    return previous[-1]
+
+
+def _index(
+    directory: str, skip: Set[str], recursive: bool = True, toolchain: bool = False
+) -> List[str]:
+    """
+    The headers under the directory, relative to it. Subdirectories that are search
+    directories of their own are indexed separately. Standard library headers such
+    as <vector> have no extension, so any file is a header in toolchain directories.
+    """
+    headers: List[str] = []
+    for root, directories, files in os.walk(directory):
+        directories[:] = [d for d in directories if os.path.join(root, d) not in skip]
+        if not recursive:
+            directories[:] = []
+        relative = os.path.relpath(root, directory)
+        for file in files:
+            extension = os.path.splitext(file)[1]
+            if extension not in _header_extensions and not (
+                toolchain and not extension
+            ):
+                continue
+            headers.append(file if relative == "." else os.path.join(relative, file))
+            if len(headers) >= _max_files:
+                return headers
+    return headers
+
+
+def _default_directories(compiler: str, language: str) -> List[str]:
+    process = subprocess.run(
+        [compiler, "-E", "-x", language, "-", "-v"],
+        stdin=subprocess.DEVNULL,
+        stdout=subprocess.DEVNULL,
+        stderr=subprocess.PIPE,
+        text=True,
+        timeout=10,
+    )
+    directories = []
+    searching = False
+    for line in process.stderr.splitlines():
+        if line.startswith("#include") and "search starts here" in line:
+            searching = True
+        elif line.startswith("End of search list"):
+            break
+        elif searching and line.startswith(" "):
+            # macOS marks framework directories.
+            directories.append(os.path.normpath(line.split(" (")[0].strip()))
+    return directories
+
+
+def _toolchain_index(compiler: str, language: str) -> Dict[str, List[str]]:
+    """
+    The default include directories of the compiler and their files, cached for
+    each compiler binary.
+    """
+    path = compiler if os.path.isabs(compiler) else None
+    if path is None:
+        for directory in os.environ.get("PATH", "").split(os.pathsep):
+            if os.path.isfile(os.path.join(directory, compiler)):
+                path = os.path.join(directory, compiler)
+                break
+    if path is None:
+        return {}
+    status = os.stat(path)
+    key = hashlib.sha256(
+        f"{os.path.realpath(path)}\0{status.st_mtime}\0{language}".encode()
+    ).hexdigest()
+    index_path = os.path.join(cache.directory(), "includes", f"{key}.json")
+    try:
+        with open(index_path, "r") as f:
+            return json.load(f)
+    except (OSError, ValueError):
+        pass
+
+    try:
+        directories = _default_directories(path, language)
+    except (OSError, subprocess.SubprocessError):
+        return {}
+    index = {d: _index(d, set(directories) - {d}, toolchain=True) for d in directories}
+    try:
+        os.makedirs(os.path.dirname(index_path), exist_ok=True)
+        handle, temporary = tempfile.mkstemp(dir=os.path.dirname(index_path))
+        with os.fdopen(handle, "w") as f:
+            json.dump(index, f)
+        os.replace(temporary, index_path)
+    except OSError:
+        # Indexed again next time.
+        pass
+    return index
+
+
+def compiler(command: List[str]) -> Optional[str]:
+    """
+    The C or C++ compiler the command runs, after launchers, or None when it runs
+    something else, such as make or a build script.
+    """
+    for argument in command:
+        name = os.path.basename(argument)
+        if name in _launchers or "=" in argument:
+            continue
+        return argument if _compiler_pattern.match(name) else None
+    return None
+
+
+def _language(compiler: str) -> str:
+    return "c++" if "++" in os.path.basename(compiler) else "c"
+
+
+def suggestions(
+    missing: str, index: Dict[str, List[str]]
+) -> List[Tuple[int, str, str]]:
+    """
+    The closest headers as (distance, include name, directory), comparing the whole
+    name and the file name alone, which finds headers moved to another directory.
+    """
+    limit = max(1, min(3, len(missing) // 4))
+    base = os.path.basename(missing)
+    found: Dict[str, Tuple[int, str, str]] = {}
+    for directory, headers in index.items():
+        for header in headers:
+            distance = _edit_distance(missing, header, limit)
+            if distance > limit and os.path.basename(header) != header:
+                moved = _edit_distance(base, os.path.basename(header), limit) + 1
+                distance = min(distance, moved)
+            if 0 < distance <= limit and header not in found:
+                found[header] = (distance, header, directory)
+    return sorted(found.values())[:_max_suggestions]
+
+
+def _patch(file: str, line: int, missing: str, replacement: str) -> Optional[str]:
+    try:
+        with open(file, "r") as f:
+            lines = f.read().splitlines()
+        old = lines[line - 1]
+    except (OSError, IndexError, UnicodeDecodeError):
+        return None
+    new = re.sub(
+        r'([<"])' + re.escape(missing) + r'([>"])', rf"\g<1>{replacement}\g<2>", old
+    )
+    if new == old:
+        return None
+    return f"--- a/{file}\n+++ b/{file}\n@@ -{line} +{line} @@\n-{old}\n+{new}\n"
+
+
+def explain(args: argparse.Namespace, diagnostic: str) -> Optional[results.Explanation]:
+    """
+    An explanation for a missing include error with a close match in the include
+    path, or None to ask the model.
+    """
+    start = time.time()
+    match = next(filter(None, map(_not_found.match, diagnostic.splitlines())), None)
+    if match is None or not args.command:
+        return None
+    missing = match.group("clang") or match.group("gcc")
+    file, line = match.group("file"), int(match.group("line"))
+
+    index: Dict[str, List[str]] = {}
+    executable = compiler(args.command)
+    if executable:
+        index.update(_toolchain_index(executable, _language(executable)))
+    # Headers next to the including file, but not the whole source tree below it.
+    directory = os.path.dirname(file) or "."
+    if directory not in index and os.path.isdir(directory):
+        index[directory] = _index(directory, set(), recursive=False)
+    for directory in flags.include_directories(args.command):
+        if directory not in index and os.path.isdir(directory):
+            index[directory] = _index(directory, set())
+
+    found = suggestions(missing, index)
+    if not found:
+        return None
+
+    _, best, directory = found[0]
+    text = f"`{missing}` is not in the include path. Did you mean `{best}`, found in "
+    text += f"`{directory}`?"
+    patch = _patch(file, line, missing, best)
+    if patch:
+        text += f"\n\n```diff\n{patch}```"
+    if len(found) > 1:
+        others = ", ".join(f"`{header}`" for _, header, _ in found[1:])
+        text += f"\n\nOther close matches: {others}."
+    return results.Explanation(
+        text=text,
+        model="local",
+        prompt_tokens=0,
+        completion_tokens=0,
+        latency=time.time() - start,
+    )
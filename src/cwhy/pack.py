@@ -0,0 +1,121 @@
+"""
+Pack files hold many cached explanations in one file that can be shared between
+machines, such as CI agents pulling it from an artifact store.
+
+A pack is a header, a compression dictionary, an index of (key, offset, length)
+sorted by key, and the entries. Each entry is compressed on its own with the shared
+dictionary, so a lookup is a binary search of the memory-mapped index followed by
+decompressing a single entry.
+"""
+
+import collections
+import mmap
+import os
+import struct
+import tempfile
+import zlib
+from typing import Dict, Iterator, List, Optional, Tuple
+
+_magic = b"CWHYPACK"
+_version = 1
+# Magic, version, number of entries, dictionary size.
+_header = struct.Struct("<8sIII")
+# Cache key (a SHA-256 digest), offset and length of the entry.
+_index_entry = struct.Struct("<32sQI")
+
+# zlib only uses the last 32 KiB of a preset dictionary.
+_dictionary_size = 32 * 1024
+_level = 9
+
+
+def train_dictionary(samples: List[bytes]) -> bytes:
+    """
+    Builds a preset dictionary from lines repeated across entries. zlib finds
+    matches closer to the end of the dictionary more cheaply, so the most frequent
+    lines come last.
+    """
+    counts: "collections.Counter[bytes]" = collections.Counter()
+    for sample in samples:
+        counts.update(set(sample.splitlines(keepends=True)))
+    lines = [line for line, count in counts.most_common() if count > 1]
+    dictionary: List[bytes] = []
+    size = 0
+    for line in lines:
+        if size + len(line) > _dictionary_size:
+            break
+        dictionary.append(line)
+        size += len(line)
+    return b"".join(reversed(dictionary))
+
+
+def _compress(data: bytes, dictionary: bytes) -> bytes:
+    if not dictionary:
+        return zlib.compress(data, _level)
+    compressor = zlib.compressobj(_level, zdict=dictionary)
+    return compressor.compress(data) + compressor.flush()
+
+
+def write(path: str, entries: Dict[str, bytes]) -> None:
+    """
+    Writes the entries, keyed by hexadecimal cache key, to a new pack.
+    """
+    dictionary = train_dictionary(list(entries.values()))
+    keys = sorted(entries)
+    blobs = [_compress(entries[key], dictionary) for key in keys]
+
+    offset = _header.size + len(dictionary) + _index_entry.size * len(keys)
+    directory = os.path.dirname(os.path.abspath(path))
+    # Write then rename, so that readers never map a partial file.
+    handle, temporary = tempfile.mkstemp(dir=directory, suffix=".tmp")
+    with os.fdopen(handle, "wb") as f:
+        f.write(_header.pack(_magic, _version, len(keys), len(dictionary)))
+        f.write(dictionary)
+        for key, blob in zip(keys, blobs):
+            f.write(_index_entry.pack(bytes.fromhex(key), offset, len(blob)))
+            offset += len(blob)
+        for blob in blobs:
+            f.write(blob)
+    # Packs are meant to be shared, unlike temporary files.
+    os.chmod(temporary, 0o644)
+    os.replace(temporary, path)
+
+
+class Pack:
+    def __init__(self, path: str):
+        self.path = path
+        with open(path, "rb") as f:
+            self.map = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+        magic, version, self.count, dictionary_size = _header.unpack_from(self.map)
+        if magic != _magic or version != _version:
+            raise ValueError(f"{path}: not a CWhy pack")
+        self.dictionary = self.map[_header.size : _header.size + dictionary_size]
+        self.index = _header.size + dictionary_size
+
+    def _entry(self, i: int) -> Tuple[bytes, int, int]:
+        return _index_entry.unpack_from(self.map, self.index + i * _index_entry.size)
+
+    def _read(self, offset: int, length: int) -> bytes:
+        decompressor = zlib.decompressobj(zdict=self.dictionary)
+        return decompressor.decompress(self.map[offset : offset + length])
+
+    def get(self, key: str) -> Optional[bytes]:
+        digest = bytes.fromhex(key)
+        low, high = 0, self.count
+        while low < high:
+            middle = (low + high) // 2
+            found, offset, length = self._entry(middle)
+            if found == digest:
+                return self._read(offset, length)
+            if found < digest:
+                low = middle + 1
+            else:
+                high = middle
+        return None
+
+    def items(self) -> Iterator[Tuple[str, bytes]]:
+        for i in range(self.count):
+            key, offset, length = self._entry(i)
+            yield key.hex(), self._read(offset, length)
+
+    def close(self) -> None:
+        self.map.close()
@@ -0,0 +1,93 @@
+"""
+Packs the prompts of small, unrelated errors into shared requests, answered with one
+structured response holding an explanation per error. This saves the per-request
+overhead and counts once against requests-per-minute limits.
+"""
+
+import argparse
+import json
+from typing import Dict, List, Optional
+
+from . import tokens
+
+# Rough time to generate one answer (about 400 tokens at 40 tokens per second),
+# used to keep bundles answerable within --timeout.
+_seconds_per_answer = 10
+
+RESPONSE_FORMAT = {
+    "type": "json_schema",
+    "json_schema": {
+        "name": "explanations",
+        "strict": True,
+        "schema": {
+            "type": "object",
+            "properties": {
+                "answers": {
+                    "type": "array",
+                    "items": {
+                        "type": "object",
+                        "properties": {
+                            "id": {"type": "string"},
+                            "explanation": {"type": "string"},
+                        },
+                        "required": ["id", "explanation"],
+                        "additionalProperties": False,
+                    },
+                }
+            },
+            "required": ["answers"],
+            "additionalProperties": False,
+        },
+    },
+}
+
+
+def bundles(args: argparse.Namespace, prompts: List[str]) -> List[List[int]]:
+    """
+    Groups prompt indices into requests of at most --pack-tokens prompt tokens, and
+    no more answers than can be generated within --timeout. Prompts larger than half
+    the budget are sent on their own.
+    """
+    max_answers = max(1, args.timeout // _seconds_per_answer)
+    result: List[List[int]] = []
+    current: List[int] = []
+    total = 0
+    for i, prompt in enumerate(prompts):
+        count = tokens.count(args.llm, prompt)
+        if count > args.pack_tokens // 2:
+            result.append([i])
+            continue
+        if current and (
+            total + count > args.pack_tokens or len(current) == max_answers
+        ):
+            result.append(current)
+            current, total = [], 0
+        current.append(i)
+        total += count
+    if current:
+        result.append(current)
+    return result
+
+
+def bundle_prompt(prompts: List[str]) -> str:
+    sections = [
+        "The following errors are unrelated. Explain each one separately, as if it "
+        "was the only question, and answer with one explanation per error ID.",
+    ]
+    for i, prompt in enumerate(prompts):
+        sections.append(f"## Error {i + 1}\n\n{prompt}")
+    return "\n\n".join(sections)
+
+
+def unpack(content: str, n: int) -> List[Optional[str]]:
+    """
+    Returns the explanation for each of the n errors, None for those the model did
+    not answer.
+    """
+    answers: Dict[str, str] = {}
+    try:
+        for answer in json.loads(content).get("answers", []):
+            answers[str(answer["id"])] = answer["explanation"]
+    except (ValueError, AttributeError, KeyError, TypeError):
+        pass
+    return [answers.get(str(i + 1)) for i in range(n)]
@@ -0,0 +1,252 @@
+"""
+Checks only the translation units affected by the staged changes, with
+`-fsyntax-only`, and explains failures with context limited to the staged hunks.
+
+Staged sources are found in `compile_commands.json`. Staged headers are mapped to
+the sources including them through the `.d` dependency files of the last build.
+Syntax checks read the working tree, which usually matches what is staged.
+"""
+
+import argparse
+import concurrent.futures
+import glob
+import json
+import os
+import re
+import shlex
+import subprocess
+import sys
+from typing import Any, Dict, List, Optional, Set, Tuple
+
+import openai
+
+from . import changes, cwhy, engine, preprocess, prompts, results
+
+_source_extensions = {".c", ".cc", ".cpp", ".cxx", ".c++", ".m", ".mm", ".cu"}
+_header_extensions = {".h", ".hh", ".hpp", ".hxx", ".h++", ".inc", ".inl", ".tpp"}
+
+# Dropped along with their value, they only concern the outputs of a build.
+_output_options = {"-o", "-MF", "-MT", "-MQ"}
+_dropped_options = {"-c", "-MD", "-MMD", "-MP"}
+
+# add_location shows lines 7 before to 3 after, so one location per 11 lines.
+_window = 11
+
+
+def staged_hunks() -> Dict[str, List[Tuple[int, int]]]:
+    """
+    The (first, last) lines added or changed by the staged changes, by absolute
+    path. Deleted files are skipped, files with only deletions have no hunks.
+    """
+    return {
+        path: [(hunk.first, hunk.last) for hunk in hunks if hunk.last >= hunk.first]
+        for path, hunks in changes.diff(
+            ["--cached", "--unified=0", "--diff-filter=ACMR"]
+        ).items()
+    }
+
+
+def find_compile_commands(root: str, path: Optional[str]) -> Optional[str]:
+    if path:
+        return path
+    candidates = [os.path.join(root, "compile_commands.json")]
+    candidates += sorted(glob.glob(os.path.join(root, "*", "compile_commands.json")))
+    for candidate in candidates:
+        if os.path.isfile(candidate):
+            return candidate
+    return None
+
+
+def _arguments(entry: Dict[str, Any]) -> List[str]:
+    if "arguments" in entry:
+        return list(entry["arguments"])
+    return shlex.split(entry["command"])
+
+
+def _entry_path(entry: Dict[str, Any]) -> str:
+    return os.path.normpath(os.path.join(entry["directory"], entry["file"]))
+
+
+def syntax_only(arguments: List[str]) -> List[str]:
+    """
+    The compile command without its outputs, checking syntax only.
+    """
+    result = []
+    skip = False
+    for argument in arguments:
+        if skip:
+            skip = False
+        elif argument in _output_options:
+            skip = True
+        elif argument in _dropped_options or argument.startswith("-o"):
+            continue
+        else:
+            result.append(argument)
+    return result[:1] + ["-fsyntax-only"] + result[1:]
+
+
+def _dependency_files(entry: Dict[str, Any]) -> List[str]:
+    """
+    Where the build may have written the entry's dependencies: the -MF argument, or
+    next to the object file as GCC (`x.d`) and CMake with Ninja (`x.o.d`) do.
+    """
+    arguments = _arguments(entry)
+    files = []
+    for option, value in zip(arguments, arguments[1:]):
+        if option == "-MF":
+            files.append(value)
+        elif option == "-o":
+            files += [os.path.splitext(value)[0] + ".d", value + ".d"]
+    if "output" in entry:
+        files.append(entry["output"] + ".d")
+    return [os.path.join(entry["directory"], file) for file in files]
+
+
+def _dependencies(path: str) -> List[str]:
+    """
+    The prerequisites listed in a Makefile-style dependency file.
+    """
+    with open(path, "r", errors="replace") as f:
+        text = f.read().replace("\\\n", " ")
+    dependencies = []
+    for rule in text.splitlines():
+        _, separator, prerequisites = rule.partition(": ")
+        if not separator:
+            continue
+        # Spaces in file names are escaped with a backslash.
+        for name in re.split(r"(?<!\\) +", prerequisites.strip()):
+            if name:
+                dependencies.append(name.replace("\\ ", " "))
+    return dependencies
+
+
+def affected_units(
+    entries: List[Dict[str, Any]], staged: Set[str]
+) -> List[Dict[str, Any]]:
+    """
+    The compile commands of staged sources, and of sources including a staged
+    header. Dependency files are only read when a header is staged.
+    """
+    units = [entry for entry in entries if _entry_path(entry) in staged]
+    headers = {
+        path for path in staged if os.path.splitext(path)[1] in _header_extensions
+    }
+    if not headers:
+        return units
+    selected = {id(entry) for entry in units}
+    for entry in entries:
+        if id(entry) in selected:
+            continue
+        for file in _dependency_files(entry):
+            if not os.path.isfile(file):
+                continue
+            directory = entry["directory"]
+            dependencies = {
+                os.path.normpath(os.path.join(directory, dependency))
+                for dependency in _dependencies(file)
+            }
+            if dependencies & headers:
+                units.append(entry)
+                selected.add(id(entry))
+            break
+    return units
+
+
+def check(entry: Dict[str, Any]) -> subprocess.CompletedProcess:
+    return subprocess.run(
+        syntax_only(_arguments(entry)),
+        cwd=entry["directory"],
+        stdout=subprocess.PIPE,
+        stderr=subprocess.STDOUT,
+        text=True,
+    )
+
+
+def hunk_locations(
+    hunks: Dict[str, List[Tuple[int, int]]], diagnostic: str
+) -> List[Tuple[str, int]]:
+    """
+    Locations covering the staged hunks of the files named in the diagnostic, or of
+    every staged file if it names none of them. Paths are relative to the current
+    directory, like the compiler's.
+    """
+    named = set()
+    for line in diagnostic.splitlines():
+        location = prompts.match_location(line)
+        if location:
+            named.add(os.path.abspath(location[0]))
+    files = [path for path in hunks if path in named] or list(hunks)
+    locations = []
+    for path in files:
+        for first, last in hunks[path]:
+            for start in range(first, last + 1, _window):
+                locations.append((os.path.relpath(path), min(start + 7, last)))
+    return locations
+
+
+def main(args: argparse.Namespace) -> None:
+    root = changes.toplevel()
+    if root is None:
+        print("Not in a Git repository.")
+        sys.exit(1)
+    hunks = staged_hunks()
+    staged = {
+        path
+        for path in hunks
+        if os.path.splitext(path)[1] in _source_extensions | _header_extensions
+    }
+    if not staged:
+        return
+
+    path = find_compile_commands(root, args.compile_commands)
+    if path is None:
+        print("compile_commands.json not found, see --compile-commands.")
+        sys.exit(1)
+    with open(path, "r") as f:
+        entries = json.load(f)
+    units = affected_units(entries, staged)
+
+    with concurrent.futures.ThreadPoolExecutor(os.cpu_count()) as executor:
+        checked = list(executor.map(check, units))
+    failures = [
+        (entry, process)
+        for entry, process in zip(units, checked)
+        if process.returncode != 0
+    ]
+    print(f"Checked {len(units)} translation units, {len(failures)} failed.")
+    if not failures:
+        return
+
+    requests = []
+    for entry, process in failures:
+        print(process.stdout)
+        os.chdir(entry["directory"])
+        # CMAKE_COLOR_DIAGNOSTICS puts -fdiagnostics-color=always in the database.
+        diagnostic = preprocess.strip_ansi(process.stdout)
+        locations = hunk_locations(hunks, diagnostic)
+        unit = argparse.Namespace(**{**vars(args), "command": _arguments(entry)})
+        requests.append(prompts.explain_prompt(unit, diagnostic, locations))
+    os.chdir(root)
+
+    if args.show_prompt:
+        print("\n\n".join(requests))
+        sys.exit(1)
+
+    print("==================================================")
+    print("CWhy")
+    print("==================================================")
+    try:
+        with engine.Client(args) as client:
+            explanations = dict(cwhy.explain_concurrently(client, args, requests))
+    except openai.OpenAIError as e:
+        print(str(e).strip())
+        sys.exit(1)
+    for i, (entry, _) in enumerate(failures):
+        result = explanations[i]
+        if isinstance(result, results.Explanation):
+            text = result.format()
+        else:
+            text = str(result).strip()
+        print(f"[{i + 1}/{len(failures)}] {entry['file']}\n\n{text}\n")
+    print("==================================================")
+    sys.exit(1)
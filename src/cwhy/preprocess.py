@@ -0,0 +1,34 @@
+"""
+Prepares tool output for parsing. Build systems such as CMake and Ninja may force
+colored diagnostics with -fdiagnostics-color=always, whose escape sequences split
+file names and line numbers, so they are stripped once before anything else reads
+the output. Checks over every line use compiled patterns rather than building a
+lowercase copy of each line, which matters for logs of hundreds of megabytes.
+"""
+
+import re
+from typing import List
+
+# Control sequences, such as colors, and operating system commands, such as the
+# hyperlinks GCC adds to warning options.
+_ansi_pattern = re.compile(
+    r"\x1b(?:\[[0-?]*[ -/]*[@-~]|\][^\x07\x1b]*(?:\x07|\x1b\\)|[@-Z\\-_])"
+)
+
+
+def strip_ansi(text: str) -> str:
+    # Most output is not colored, and looking for the escape character is cheap.
+    if "\x1b" not in text:
+        return text
+    return _ansi_pattern.sub("", text)
+
+
+def lines(text: str) -> List[str]:
+    return strip_ansi(text).splitlines()
+
+
+def keyword(word: str) -> "re.Pattern[str]":
+    """
+    A case-insensitive search for the word, equivalent to `word in line.lower()`.
+    """
+    return re.compile(re.escape(word), re.IGNORECASE)
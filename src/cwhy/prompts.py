@@ -1,11 +1,14 @@
 import argparse
 import collections
+import os
 import re
 import sys
-from typing import Dict, List, Optional
+from typing import Dict, List, Optional, Tuple
 
 import llm_utils
 
+from . import changes, flags, preprocess, snippets, structured, tokens
+
 
 # Define error patterns with associated information. The numbers
 # correspond to the groups matching file name and line number.
@@ -43,126 +46,193 @@ _error_patterns = [
 ]
 
 
+# The include chain printed by GCC and Clang before the error.
+_included_from = re.compile(r"^(?:In file included from|\s+from) (.+?):(\d+)[:,]")
+
+# Every location pattern has a line number after one of these, which rules out most
+# lines of a long log with a single search.
+_location_hint = re.compile(r"[:(\[]\d|line \d")
+_warning = preprocess.keyword("warning")
+
+
+def match_location(line: str) -> Optional[Tuple[str, int]]:
+    """
+    Returns the file name and line number a diagnostic line refers to, if any.
+    """
+    if not _location_hint.search(line):
+        return None
+    for _, pattern, file_group, line_group in _error_patterns:
+        match = pattern.match(line)
+        # Rule out messages that contain the word 'warning' (for LaTeX; these match Java's regex)
+        if match and not _warning.search(line):
+            # Extract information based on group indices
+            file_name = match.group(file_group).lstrip()
+            line_number = int(match.group(line_group))
+            if file_name and line_number:
+                return (file_name, line_number)
+            return None
+    return None
+
+
+def _format_file_locations(filename: str, lines: Dict[int, str]) -> str:
+    """
+    Format all the lines from a single file as a code block.
+    There may be multiple groups: lines 1-10 and 100-110 for example.
+
+    Args:
+        filename: The name of the file lines originate from.
+        lines: A mapping of line numbers to the corresponding line content.
+
+    Returns:
+        One or more concatenated formatted code blocks.
+    """
+    # Sort lines by line number.
+    sorted_lines = sorted(lines.items(), key=lambda x: x[0])
+
+    result = ""
+    last = None
+    group = []
+    for line_number, line_content in sorted_lines:
+        if last is None or line_number == last + 1:
+            group.append(line_content)
+            last = line_number
+        else:
+            result += f"File `{filename}`:\n```\n"
+            result += llm_utils.number_group_of_lines(group, last - len(group) + 1)
+            result += "\n```\n\n"
+            last = None
+            group = []
+    if last is not None:
+        result += f"File `{filename}`:\n```\n"
+        result += llm_utils.number_group_of_lines(group, last - len(group) + 1)
+        result += "\n```\n\n"
+    return result
+
+
 class _Context:
-    def __init__(self, args: argparse.Namespace, diagnostic: str):
+    def __init__(
+        self,
+        args: argparse.Namespace,
+        diagnostic: str,
+        locations: Optional[List[Tuple[str, int]]] = None,
+    ):
         self.args = args
-        self.diagnostic_lines = diagnostic.splitlines()
+        self.diagnostic_lines = preprocess.lines(diagnostic)
+
+        # We group by source file. The lines around each location are read when the
+        # code section is built, unless the block is in the snippet cache.
+        self.code_locations: Dict[str, List[Tuple[int, int]]] = collections.defaultdict(
+            list
+        )
+        self.file_status: Dict[str, os.stat_result] = {}
+        # The lines the error points to, by file, to rank changes with --git-context.
+        self.error_lines: Dict[str, List[int]] = collections.defaultdict(list)
 
-        # We group by source file.
-        self.code_locations: Dict[str, Dict[int, str]] = collections.defaultdict(dict)
+        # Front ends already know where the errors are.
+        if locations is not None:
+            for file_name, line_number in locations:
+                self.add_location(file_name, line_number)
+            return
 
         # Go through the diagnostic and build up a list of code locations.
         for line in self.diagnostic_lines:
-            file_name = None
-            line_number = None
-            for _, pattern, file_group, line_group in _error_patterns:
-                match = pattern.match(line)
-                # Rule out messages that contain the word 'warning' (for LaTeX; these match Java's regex)
-                if match and "warning" not in line.lower():
-                    # Extract information based on group indices
-                    file_name = match.group(file_group).lstrip()
-                    line_number = int(match.group(line_group))
-                    break  # Move to the next line after a match
-
-            if not file_name or not line_number:
-                continue
-
-            try:
-                (abridged_code, line_start) = llm_utils.read_lines(
-                    file_name, line_number - 7, line_number + 3
-                )
-            except FileNotFoundError:
-                print(
-                    f"[CWHY WARNING] file not found: {file_name.lstrip()}",
-                    file=sys.stderr,
-                )
-                continue
+            location = match_location(line)
+            if location:
+                self.add_location(*location)
 
+    def add_location(self, file_name: str, line_number: int) -> None:
+        self.error_lines[file_name].append(line_number)
+        try:
+            self.file_status[file_name] = os.stat(file_name)
+        except FileNotFoundError:
+            print(
+                f"[CWHY WARNING] file not found: {file_name.lstrip()}",
+                file=sys.stderr,
+            )
+            return
+
+        self.code_locations[file_name].append((line_number - 7, line_number + 3))
+
+    def get_snippet(self, file_name: str) -> snippets.Snippet:
+        """
+        The code blocks shown for a file and their token count, from the snippet
+        cache when the file has not changed since they were formatted.
+        """
+        windows = sorted(set(self.code_locations[file_name]))
+        status = self.file_status[file_name]
+        key = snippets.key(self.args.llm, file_name, status, windows)
+        snippet = snippets.get(key)
+        if snippet is not None:
+            return snippet
+
+        lines: Dict[int, str] = {}
+        for start, end in windows:
+            (abridged_code, line_start) = llm_utils.read_lines(file_name, start, end)
             for i, line_content in enumerate(abridged_code):
-                self.code_locations[file_name][line_start + i] = line_content
+                lines[line_start + i] = line_content
+        text = _format_file_locations(file_name, lines)
+        snippet = snippets.Snippet(text, tokens.count(self.args.llm, text))
+        # Not cached when the file changed while it was read.
+        if os.stat(file_name).st_mtime_ns == status.st_mtime_ns:
+            snippets.put(key, snippet)
+        return snippet
 
     def get_diagnostic(self) -> str:
         """
         Alternate taking front and back lines until the maximum number of tokens.
         """
-        front: List[str] = []
-        back: List[str] = []
         n = len(self.diagnostic_lines)
 
-        def build_diagnostic_string() -> str:
+        def build_diagnostic_string(k: int) -> str:
+            # The first k lines, alternating between the front and the back.
+            front = self.diagnostic_lines[: (k + 1) // 2]
+            back = self.diagnostic_lines[n - k // 2 :]
             return (
                 "```\n"
                 + "\n".join(front)
                 + "\n\n[...]\n\n"
-                + "\n".join(reversed(back))
+                + "\n".join(back)
                 + "\n```\n"
             )
 
-        for i in range(n):
-            if i % 2 == 0:
-                line = self.diagnostic_lines[i // 2]
-                list = front
-            else:
-                line = self.diagnostic_lines[n - i // 2 - 1]
-                list = back
-            list.append(line)
-            count = llm_utils.count_tokens(self.args.llm, build_diagnostic_string())
-            if count > self.args.max_error_tokens:
-                list.pop()
-                break
-
-        if len(front) + len(back) == n:
+        k = tokens.largest_within(
+            lambda k: tokens.count(self.args.llm, build_diagnostic_string(k)),
+            n,
+            self.args.max_error_tokens,
+        )
+        if k == n:
             return "```\n" + "\n".join(self.diagnostic_lines) + "\n```\n"
-        return build_diagnostic_string()
+        return build_diagnostic_string(k)
+
+    def get_changes(self) -> List[str]:
+        """
+        The hunks changed since --git-base in the files the error goes through,
+        closest to the error first.
+        """
+        if not self.args.git_context:
+            return []
+        files = dict(self.error_lines)
+        for line in self.diagnostic_lines:
+            match = _included_from.match(line)
+            if match:
+                files.setdefault(match.group(1), [])
+        base = self.args.git_base
+        return [
+            f"Changes to `{name}` since {base}:\n```diff\n{hunk.text}\n```\n\n"
+            for name, hunk in changes.ranked(base, files)
+        ]
 
     def get_code(self) -> Optional[str]:
-        if not self.code_locations:
+        changed = self.get_changes()
+        if not self.code_locations and not changed:
             return None
 
-        def format_file_locations(filename: str, lines: Dict[int, str]) -> str:
-            """
-            Format all the lines from a single file as a code block.
-            There may be multiple groups: lines 1-10 and 100-110 for example.
-
-            Args:
-                filename: The name of the file lines originate from.
-                lines: A mapping of line numbers to the corresponding line content.
-
-            Returns:
-                One or more concatenated formatted code blocks.
-            """
-            # Sort lines by line number.
-            sorted_lines = sorted(lines.items(), key=lambda x: x[0])
+        # Changes come first in the budget, they often make windows unnecessary.
+        blocks = [snippets.Snippet(x, tokens.count(self.args.llm, x)) for x in changed]
+        blocks += [self.get_snippet(file_name) for file_name in self.code_locations]
 
-            result = ""
-            last = None
-            group = []
-            for line_number, line_content in sorted_lines:
-                if last is None or line_number == last + 1:
-                    group.append(line_content)
-                    last = line_number
-                else:
-                    result += f"File `{filename}`:\n```\n"
-                    result += llm_utils.number_group_of_lines(
-                        group, last - len(group) + 1
-                    )
-                    result += "\n```\n\n"
-                    last = None
-                    group = []
-            if last is not None:
-                result += f"File `{filename}`:\n```\n"
-                result += llm_utils.number_group_of_lines(group, last - len(group) + 1)
-                result += "\n```\n\n"
-            return result
-
-        formatted_file_locations = [
-            format_file_locations(filename, sorted_lines)
-            for filename, sorted_lines in self.code_locations.items()
-        ]
-
-        counts = [
-            llm_utils.count_tokens(self.args.llm, x) for x in formatted_file_locations
-        ]
+        formatted_file_locations = [block.text for block in blocks]
+        counts = [block.tokens for block in blocks]
         index = 0
         total = 0
         while (
@@ -173,8 +243,19 @@ class _Context:
         return "".join(formatted_file_locations[:index])
 
 
-def _base_prompt(args: argparse.Namespace, diagnostic: str) -> str:
-    ctx = _Context(args, diagnostic)
+_explain_question = "What's the problem? If you can, suggest code to fix the issue."
+_summary_question = (
+    "In one sentence, what is the root cause of this error, and at which file and "
+    "line? Do not suggest a fix."
+)
+
+
+def _base_prompt(
+    args: argparse.Namespace,
+    diagnostic: str,
+    locations: Optional[List[Tuple[str, int]]] = None,
+) -> str:
+    ctx = _Context(args, diagnostic, locations)
 
     prompt = ""
     code = ctx.get_code()
@@ -182,6 +263,10 @@ def _base_prompt(args: argparse.Namespace, diagnostic: str) -> str:
         prompt += "This is my code:\n\n"
         prompt += code
         prompt += "\n"
+    if args.command_context and args.command:
+        prompt += "This is my command:\n```\n"
+        prompt += flags.summarize(args.command, diagnostic)
+        prompt += "\n```\n\n"
     prompt += "This is my error:\n"
     prompt += ctx.get_diagnostic()
     prompt += "\n\n"
@@ -189,8 +274,22 @@ def _base_prompt(args: argparse.Namespace, diagnostic: str) -> str:
     return prompt
 
 
-def explain_prompt(args: argparse.Namespace, diagnostic: str) -> str:
-    return (
-        _base_prompt(args, diagnostic)
-        + "What's the problem? If you can, suggest code to fix the issue."
-    )
+def explain_prompt(
+    args: argparse.Namespace,
+    diagnostic: str,
+    locations: Optional[List[Tuple[str, int]]] = None,
+) -> str:
+    question = structured.QUESTION if args.structured else _explain_question
+    return _base_prompt(args, diagnostic, locations) + question
+
+
+def summary_prompt(prompt: str) -> str:
+    """
+    Turns an explain prompt into one asking for the root cause only. The code and
+    error come first in both, so the provider can reuse the cached prefix when the
+    full explanation is requested next.
+    """
+    for question in [_explain_question, structured.QUESTION]:
+        if prompt.endswith(question):
+            return prompt[: -len(question)] + _summary_question
+    raise ValueError("not an explain prompt")
@@ -0,0 +1,194 @@
+"""
+Static HTML report of the results collected with `--format json --output FILE`,
+typically appended to by every failing compiler invocation of a build.
+
+The results files are read twice: once to index entries by fingerprint, keeping
+only byte offsets, and once to render each group. Only the index and a bounded
+number of rows per group are held in memory, so reports with tens of thousands of
+entries are written incrementally.
+"""
+
+import argparse
+import collections
+import dataclasses
+import html
+import json
+import re
+import shlex
+from typing import IO, Any, Dict, List, Optional, Set
+
+from .results import Position, entry_fingerprint, scan
+
+# Occurrences listed per group, the rest are only counted.
+_max_rows = 100
+
+_code_block_pattern = re.compile(r"```[^\n]*\n(.*?)```", re.DOTALL)
+
+
+@dataclasses.dataclass
+class _Group:
+    key: str
+    entries: List[Position] = dataclasses.field(default_factory=list)
+    occurrences: int = 0
+
+
+def _location(record: Dict[str, Any]) -> str:
+    result = record.get("file") or ""
+    if record.get("line") is not None:
+        result += f":{record['line']}"
+        if record.get("column") is not None:
+            result += f":{record['column']}"
+    return result
+
+
+def _markdown(text: str) -> str:
+    """
+    Minimal rendering: fenced code blocks and paragraphs.
+    """
+    result: List[str] = []
+    for i, part in enumerate(_code_block_pattern.split(text)):
+        if i % 2:
+            result.append(f"<pre><code>{html.escape(part)}</code></pre>")
+            continue
+        for paragraph in re.split(r"\n\s*\n", part):
+            if paragraph.strip():
+                result.append(f"<p>{html.escape(paragraph.strip())}</p>")
+    return "\n".join(result)
+
+
+_header = """<!DOCTYPE html>
+<html lang="en">
+<head>
+<meta charset="utf-8">
+<title>CWhy report</title>
+<style>
+body { font-family: sans-serif; max-width: 70em; margin: auto; padding: 1em; }
+input { width: 100%; font-size: 1.1em; padding: 0.3em; }
+section { border-top: 1px solid #ccc; padding: 0.5em 0; }
+p { white-space: pre-wrap; }
+pre { background: #f4f4f4; padding: 0.5em; overflow-x: auto; }
+.meta, .command { color: #666; }
+.error { color: #a00; }
+.hidden { display: none; }
+</style>
+</head>
+<body>
+<h1>CWhy report</h1>
+"""
+
+# Each section and file entry carries its lowercased search terms, so filtering
+# needs no separate index to be loaded.
+_footer = """<script>
+document.getElementById("search").addEventListener("input", function (event) {
+  var words = event.target.value.toLowerCase().split(/\\s+/).filter(Boolean);
+  document.querySelectorAll("[data-search]").forEach(function (element) {
+    var text = element.getAttribute("data-search");
+    var match = words.every(function (word) { return text.indexOf(word) >= 0; });
+    element.classList.toggle("hidden", !match);
+  });
+});
+</script>
+</body>
+</html>
+"""
+
+
+def _write_group(
+    stream: IO[str], handles: List[IO[bytes]], identifier: str, group: _Group
+) -> None:
+    explanation: Optional[str] = None
+    error: Optional[str] = None
+    rows: List[str] = []
+    terms: Set[str] = {group.key.lower()}
+    remaining = 0
+
+    for i, offset in group.entries:
+        handles[i].seek(offset)
+        entry = json.loads(handles[i].readline())
+        if explanation is None and entry.get("explanation"):
+            explanation = entry["explanation"]
+        elif error is None and entry.get("error"):
+            error = entry["error"]
+        command = shlex.join(entry.get("command") or [])
+        records = entry.get("records", [])
+        for record in records:
+            if len(rows) == _max_rows:
+                remaining += 1
+                continue
+            rows.append(
+                f"<li><code>{html.escape(_location(record))}</code> "
+                f"{html.escape(record.get('message', ''))} "
+                f'<span class="command">{html.escape(command)}</span></li>'
+            )
+            terms.add((record.get("file") or "").lower())
+            terms.add(record.get("message", "").lower())
+        remaining += max(0, entry.get("occurrences", 0) - len(records))
+
+    search = html.escape(" ".join(sorted(terms)), quote=True)
+    stream.write(f'<section id="fp-{identifier}" data-search="{search}">\n')
+    stream.write(f"<h3>{html.escape(group.key)}</h3>\n")
+    stream.write(
+        f'<p class="meta">{group.occurrences} occurrences in '
+        f"{len(group.entries)} commands, fingerprint {identifier}</p>\n"
+    )
+    if explanation is not None:
+        stream.write(_markdown(explanation) + "\n")
+    elif error is not None:
+        stream.write(f'<p class="error">{html.escape(error)}</p>\n')
+    stream.write("<details><summary>Occurrences</summary>\n<ul>\n")
+    stream.write("\n".join(rows) + "\n")
+    if remaining:
+        stream.write(f"<li>[... {remaining} more occurrences ...]</li>\n")
+    stream.write("</ul>\n</details>\n</section>\n")
+
+
+def write_html(paths: List[str], stream: IO[str]) -> None:
+    groups: Dict[str, _Group] = collections.OrderedDict()
+    files: Dict[str, Set[str]] = {}
+    for position, entry in scan(paths):
+        key = entry_fingerprint(entry)
+        group = groups.setdefault(key, _Group(entry.get("key", "")))
+        group.entries.append(position)
+        group.occurrences += entry.get("occurrences", 1)
+        for record in entry.get("records", []):
+            if record.get("file"):
+                files.setdefault(record["file"], set()).add(key)
+
+    # Most frequent root causes first.
+    ordered = sorted(groups.items(), key=lambda item: -item[1].occurrences)
+    rank = {key: i for i, (key, _) in enumerate(ordered)}
+    occurrences = sum(group.occurrences for group in groups.values())
+
+    stream.write(_header)
+    stream.write(
+        f'<p class="meta">{occurrences} errors, {len(groups)} root causes, '
+        f"{len(files)} files.</p>\n"
+    )
+    stream.write('<input id="search" type="search" placeholder="Filter...">\n')
+    stream.write("<h2>By root cause</h2>\n")
+    handles: List[IO[bytes]] = [open(path, "rb") for path in paths]
+    try:
+        for key, group in ordered:
+            _write_group(stream, handles, key, group)
+    finally:
+        for handle in handles:
+            handle.close()
+
+    stream.write("<h2>By file</h2>\n<ul>\n")
+    for file in sorted(files):
+        links = ", ".join(
+            f'<a href="#fp-{key}">{html.escape(groups[key].key)}</a>'
+            for key in sorted(files[file], key=rank.__getitem__)
+        )
+        search = html.escape(file.lower(), quote=True)
+        stream.write(
+            f'<li data-search="{search}"><code>{html.escape(file)}</code>: '
+            f"{links}</li>\n"
+        )
+    stream.write("</ul>\n")
+    stream.write(_footer)
+
+
+def main(args: argparse.Namespace) -> None:
+    with open(args.html, "w", encoding="utf-8") as f:
+        write_html(args.results, f)
@@ -0,0 +1,376 @@
+import argparse
+import contextlib
+import dataclasses
+import hashlib
+import importlib.metadata
+import json
+import os
+import pathlib
+import re
+import sys
+import tempfile
+import urllib.parse
+from typing import IO, Any, Dict, Iterator, List, Optional, Tuple, Union
+
+import llm_utils
+
+try:
+    import fcntl
+except ImportError:
+    # Windows, where concurrent invocations are not serialized.
+    fcntl = None  # type: ignore
+
+from .frontends.records import ErrorCluster, ErrorRecord, fingerprint
+
+_patch_pattern = re.compile(r"```(?:diff|patch)\n(.*?)```", re.DOTALL)
+
+
+@dataclasses.dataclass
+class Explanation:
+    text: str
+    model: str
+    prompt_tokens: int
+    completion_tokens: int
+    # Wall-clock time spent waiting for the API, in seconds.
+    latency: float
+    cached: bool = False
+
+    def patch(self) -> Optional[str]:
+        """
+        Returns the first unified diff in the explanation, if the model wrote one.
+        """
+        match = _patch_pattern.search(self.text)
+        return match.group(1) if match else None
+
+    def format(self, wrap: bool = True) -> str:
+        text = self.text
+        if wrap:
+            text = llm_utils.word_wrap_except_code_blocks(text)
+
+        text += "\n\n"
+        text += f"({self.latency:.1f} seconds, "
+        text += f"{self.prompt_tokens} prompt tokens, "
+        text += f"{self.completion_tokens} completion tokens.)"
+        return text
+
+
+def _record_json(record: ErrorRecord) -> Dict[str, Any]:
+    fields = {
+        "file": record.file,
+        "line": record.line,
+        "column": record.column,
+        "endLine": record.end_line,
+        "endColumn": record.end_column,
+        "code": record.code,
+        "group": record.group,
+        "message": record.message,
+    }
+    return {k: v for k, v in fields.items() if v is not None}
+
+
+def explanation_json(explanation: Explanation) -> Dict[str, Any]:
+    return {
+        "explanation": explanation.text,
+        "patch": explanation.patch(),
+        "model": explanation.model,
+        "promptTokens": explanation.prompt_tokens,
+        "completionTokens": explanation.completion_tokens,
+        "latency": round(explanation.latency, 3),
+        "cached": explanation.cached,
+    }
+
+
+class Writer:
+    """
+    Streams results as they complete, so that memory does not grow with the
+    number of errors.
+    """
+
+    def __init__(self, args: argparse.Namespace, stream: IO[str]):
+        self.args = args
+        self.stream = stream
+
+    def __enter__(self) -> "Writer":
+        return self
+
+    def __exit__(self, *exc: Any) -> None:
+        self.close()
+
+    def write(
+        self, cluster: ErrorCluster, result: Union[Explanation, Exception]
+    ) -> None:
+        raise NotImplementedError
+
+    def record(
+        self,
+        cluster: ErrorCluster,
+        diagnostic: str,
+        locations: Optional[List[Tuple[str, int]]],
+    ) -> None:
+        """
+        Write a cluster without explaining it, with what is needed to build the
+        prompt later.
+        """
+        raise NotImplementedError
+
+    def close(self) -> None:
+        self.stream.flush()
+        if self.stream is not sys.stdout:
+            self.stream.close()
+
+
+class JsonWriter(Writer):
+    """
+    One JSON object per line. Several builds can append to the same file.
+    """
+
+    def entry(self, cluster: ErrorCluster) -> Dict[str, Any]:
+        return {
+            "command": self.args.command,
+            "directory": os.getcwd(),
+            "key": cluster.key,
+            "fingerprint": cluster.fingerprint(),
+            "occurrences": len(cluster.records),
+            "records": [_record_json(r) for r in cluster.representatives()],
+        }
+
+    def write(
+        self, cluster: ErrorCluster, result: Union[Explanation, Exception]
+    ) -> None:
+        entry = self.entry(cluster)
+        if isinstance(result, Explanation):
+            entry.update(explanation_json(result))
+        else:
+            entry["error"] = str(result).strip()
+        self.stream.write(json.dumps(entry) + "\n")
+        self.stream.flush()
+
+    def record(
+        self,
+        cluster: ErrorCluster,
+        diagnostic: str,
+        locations: Optional[List[Tuple[str, int]]],
+    ) -> None:
+        entry = self.entry(cluster)
+        entry["diagnostic"] = diagnostic
+        if locations is not None:
+            entry["locations"] = locations
+        # Lets `cwhy browse` tell when sources changed since the failure.
+        entry["sources"] = {}
+        for record in cluster.representatives():
+            if record.file and record.file not in entry["sources"]:
+                digest = file_digest(record.file)
+                if digest:
+                    entry["sources"][record.file] = digest
+        self.stream.write(json.dumps(entry) + "\n")
+        self.stream.flush()
+
+
+class SarifWriter(Writer):
+    """
+    A SARIF 2.1.0 log with one run per invocation and one result per cluster. The
+    explanation is attached as a related location message, which editors show next
+    to the diagnostic.
+    """
+
+    def __init__(
+        self,
+        args: argparse.Namespace,
+        stream: IO[str],
+        destination: Optional[str] = None,
+    ):
+        """
+        With a destination, the stream is a temporary file, added as a run to the
+        log at the destination once complete.
+        """
+        super().__init__(args, stream)
+        self.destination = destination
+        self.first = True
+        driver = {
+            "name": "CWhy",
+            "version": importlib.metadata.version("cwhy"),
+            "informationUri": "https://github.com/plasma-umass/cwhy",
+        }
+        run = {
+            "tool": {"driver": driver},
+            # Relative paths are relative to where the command ran.
+            "originalUriBaseIds": {
+                "SRCROOT": {"uri": pathlib.Path(os.getcwd()).as_uri() + "/"}
+            },
+            "results": [],
+        }
+        header = json.dumps(
+            {
+                "$schema": "https://json.schemastore.org/sarif-2.1.0.json",
+                "version": "2.1.0",
+                "runs": [run],
+            }
+        )
+        # Leave the results array open, results are written as they arrive.
+        self.stream.write(header[: header.rindex("[]")] + "[\n")
+
+    @staticmethod
+    def artifact(file: str) -> Dict[str, str]:
+        if os.path.isabs(file):
+            return {"uri": pathlib.Path(file).as_uri()}
+        return {
+            "uri": urllib.parse.quote(pathlib.Path(file).as_posix()),
+            "uriBaseId": "SRCROOT",
+        }
+
+    @staticmethod
+    def location(record: ErrorRecord, message: Optional[str] = None) -> Dict:
+        region = {
+            "startLine": record.line,
+            "startColumn": record.column,
+            "endLine": record.end_line,
+            "endColumn": record.end_column,
+        }
+        location: Dict[str, Any] = {
+            "physicalLocation": {
+                "artifactLocation": SarifWriter.artifact(record.file or ""),
+                "region": {k: v for k, v in region.items() if v is not None},
+            }
+        }
+        if message:
+            location["message"] = {"text": message}
+        return location
+
+    def write(
+        self, cluster: ErrorCluster, result: Union[Explanation, Exception]
+    ) -> None:
+        records = [r for r in cluster.representatives() if r.file]
+        primary = cluster.records[0]
+        entry: Dict[str, Any] = {
+            "ruleId": primary.code or "error",
+            "level": "error",
+            "message": {"text": primary.message},
+        }
+        if records:
+            entry["locations"] = [self.location(records[0])]
+        related: List[Dict] = []
+        if isinstance(result, Explanation):
+            entry["properties"] = explanation_json(result)
+            if records:
+                related.append(self.location(records[0], result.text))
+        else:
+            entry["properties"] = {"error": str(result).strip()}
+        related.extend(self.location(r, r.message) for r in records[1:])
+        if related:
+            for i, location in enumerate(related):
+                location["id"] = i
+            entry["relatedLocations"] = related
+
+        if not self.first:
+            self.stream.write(",\n")
+        self.first = False
+        self.stream.write(json.dumps(entry))
+        self.stream.flush()
+
+    def close(self) -> None:
+        self.stream.write("\n]}]}\n")
+        super().close()
+        if self.destination:
+            # Read the log only now, under the lock, since other invocations of a
+            # parallel build may have added their runs meanwhile.
+            with _locked(self.destination):
+                with open(self.stream.name, "r") as f:
+                    log = json.load(f)
+                log["runs"] = [*sarif_runs(self.destination), *log["runs"]]
+                with open(self.stream.name, "w") as f:
+                    json.dump(log, f)
+                os.replace(self.stream.name, self.destination)
+
+
+@contextlib.contextmanager
+def _locked(path: str) -> Iterator[None]:
+    """
+    Holds an exclusive lock on a file next to path, for concurrent invocations to
+    take turns.
+    """
+    with open(path + ".lock", "a") as f:
+        if fcntl:
+            fcntl.flock(f.fileno(), fcntl.LOCK_EX)
+        try:
+            yield
+        finally:
+            if fcntl:
+                fcntl.flock(f.fileno(), fcntl.LOCK_UN)
+
+
+def open_writer(args: argparse.Namespace) -> Writer:
+    if args.format == "json" or args.lazy:
+        stream = open(args.output, "a") if args.output else sys.stdout
+        return JsonWriter(args, stream)
+    elif args.format == "sarif":
+        if not args.output:
+            return SarifWriter(args, sys.stdout)
+        if os.path.isdir(args.output):
+            # One log per invocation, for parallel builds.
+            handle, _ = tempfile.mkstemp(
+                prefix="cwhy-", suffix=".sarif", dir=args.output
+            )
+            return SarifWriter(args, os.fdopen(handle, "w"))
+        # Add a run to the log, once the run is complete.
+        stream = tempfile.NamedTemporaryFile(
+            "w",
+            dir=os.path.dirname(os.path.abspath(args.output)),
+            suffix=".tmp",
+            delete=False,
+        )
+        return SarifWriter(args, stream, args.output)
+    else:
+        raise Exception(f"unknown format: {args.format}")
+
+
+def sarif_runs(path: str) -> List[Dict[str, Any]]:
+    """
+    The runs of an existing SARIF log, or none if it is missing or not a log.
+    """
+    try:
+        with open(path, "r") as f:
+            runs = json.load(f).get("runs")
+    except (OSError, ValueError, AttributeError):
+        return []
+    return runs if isinstance(runs, list) else []
+
+
+def file_digest(path: str) -> Optional[str]:
+    try:
+        with open(path, "rb") as f:
+            return hashlib.sha256(f.read()).hexdigest()[:16]
+    except OSError:
+        return None
+
+
+# (index of the results file, byte offset of the line)
+Position = Tuple[int, int]
+
+
+def scan(paths: List[str]) -> Iterator[Tuple[Position, Dict[str, Any]]]:
+    """
+    Reads JSON results files one line at a time, yielding each entry with its
+    position so it can be read again later without keeping it in memory.
+    """
+    for i, path in enumerate(paths):
+        with open(path, "rb") as f:
+            while True:
+                offset = f.tell()
+                line = f.readline()
+                if not line:
+                    break
+                try:
+                    entry = json.loads(line)
+                except json.JSONDecodeError:
+                    # Blank, or truncated by an interrupted build.
+                    continue
+                yield (i, offset), entry
+
+
+def entry_fingerprint(entry: Dict[str, Any]) -> str:
+    if entry.get("fingerprint"):
+        return str(entry["fingerprint"])
+    records = entry.get("records") or [{}]
+    return fingerprint(
+        records[0].get("code"), records[0].get("message") or entry.get("key", "")
+    )
@@ -0,0 +1,77 @@
+"""
+Persistent cache of the code blocks shown in prompts. The same library headers,
+such as libstdc++'s hashtable_policy.h, appear in prompt after prompt, and reading,
+numbering and counting the tokens of their lines is most of the cost of the code
+section. A block is keyed by the identity of its file (path, inode, modification
+time and size), the windows shown, and the model counting its tokens, so that an
+edited file is read again.
+"""
+
+import dataclasses
+import hashlib
+import json
+import os
+import tempfile
+from typing import Dict, List, Optional, Tuple
+
+from . import cache
+
+# Changed when blocks are formatted differently.
+_version = 1
+
+
+@dataclasses.dataclass(frozen=True)
+class Snippet:
+    text: str
+    tokens: int
+
+
+# Blocks used in this process, since errors in the same header come in groups.
+_memo: Dict[str, Snippet] = {}
+
+
+def key(
+    model: str, file: str, status: os.stat_result, windows: List[Tuple[int, int]]
+) -> str:
+    identity = [
+        _version,
+        model,
+        file,
+        os.path.abspath(file),
+        status.st_ino,
+        status.st_mtime_ns,
+        status.st_size,
+        windows,
+    ]
+    return hashlib.sha256(json.dumps(identity).encode()).hexdigest()
+
+
+def _path(key: str) -> str:
+    return os.path.join(cache.directory(), "snippets", key[:2], f"{key}.json")
+
+
+def get(key: str) -> Optional[Snippet]:
+    if key in _memo:
+        return _memo[key]
+    try:
+        with open(_path(key), "r") as f:
+            snippet = Snippet(**json.load(f))
+    except (OSError, ValueError, TypeError):
+        return None
+    _memo[key] = snippet
+    return snippet
+
+
+def put(key: str, snippet: Snippet) -> None:
+    _memo[key] = snippet
+    path = _path(key)
+    try:
+        os.makedirs(os.path.dirname(path), exist_ok=True)
+        # Write then rename, so that concurrent builds never read a partial file.
+        handle, temporary = tempfile.mkstemp(dir=os.path.dirname(path), suffix=".tmp")
+        with os.fdopen(handle, "w") as f:
+            json.dump(dataclasses.asdict(snippet), f)
+        os.replace(temporary, path)
+    except OSError:
+        # Prompts do not depend on the cache being writable.
+        pass
@@ -0,0 +1,158 @@
+"""
+Structured explanations, requested with --structured. The model answers with JSON
+following RESPONSE_FORMAT, which is validated here and rendered to markdown. The
+patch is a separate field, so it can be checked and applied without parsing prose,
+and answers stay short enough for a smaller max_tokens.
+"""
+
+import dataclasses
+import json
+import re
+from typing import Any, List, Tuple
+
+QUESTION = (
+    "What's the root cause of this error, and where is it? If you can, give the "
+    "fix as a unified diff against the files shown."
+)
+
+# Room for a few paragraphs and a patch, instead of the model's default maximum.
+MAX_TOKENS = 1024
+
+RESPONSE_FORMAT = {
+    "type": "json_schema",
+    "json_schema": {
+        "name": "explanation",
+        "strict": True,
+        "schema": {
+            "type": "object",
+            "properties": {
+                "root_cause": {"type": "string"},
+                "locations": {
+                    "type": "array",
+                    "items": {
+                        "type": "object",
+                        "properties": {
+                            "file": {"type": "string"},
+                            "line": {"type": "integer"},
+                        },
+                        "required": ["file", "line"],
+                        "additionalProperties": False,
+                    },
+                },
+                "explanation": {"type": "string"},
+                "patch": {"type": "string"},
+                "confidence": {"type": "number"},
+            },
+            "required": [
+                "root_cause",
+                "locations",
+                "explanation",
+                "patch",
+                "confidence",
+            ],
+            "additionalProperties": False,
+        },
+    },
+}
+
+_hunk_header = re.compile(r"^@@ -\d+(,\d+)? \+\d+(,\d+)? @@")
+
+
+@dataclasses.dataclass
+class Answer:
+    root_cause: str
+    locations: List[Tuple[str, int]]
+    explanation: str
+    # A unified diff, empty when the model did not suggest one.
+    patch: str
+    # Between 0 and 1.
+    confidence: float
+
+
+def requested(prompt: str) -> bool:
+    return prompt.endswith(QUESTION)
+
+
+def _field(fields: Any, name: str, kind: Any) -> Any:
+    value = fields.get(name)
+    if not isinstance(value, kind) or isinstance(value, bool):
+        raise ValueError(f"invalid {name}: {value!r}")
+    return value
+
+
+def valid_patch(patch: str) -> bool:
+    """
+    Checks that the patch is a well-formed unified diff: file headers followed by
+    hunks whose line counts match their headers.
+    """
+    lines = patch.splitlines()
+    if not any(line.startswith("--- ") for line in lines) or not any(
+        line.startswith("+++ ") for line in lines
+    ):
+        return False
+    hunks = 0
+    old = new = 0
+    for line in lines:
+        if old > 0 or new > 0:
+            if line.startswith("\\"):
+                continue
+            if line.startswith(" ") or line == "":
+                old, new = old - 1, new - 1
+            elif line.startswith("-"):
+                old -= 1
+            elif line.startswith("+"):
+                new -= 1
+            else:
+                return False
+            continue
+        match = _hunk_header.match(line)
+        if match:
+            counts = re.findall(r"[-+]\d+(?:,(\d+))?", line.split("@@")[1])
+            old, new = (int(count) if count else 1 for count in counts)
+            hunks += 1
+        elif not line.startswith(("--- ", "+++ ", "diff ", "index ")):
+            return False
+    return hunks > 0 and old == 0 and new == 0
+
+
+def parse(content: str) -> Answer:
+    """
+    Returns the validated answer, raises ValueError when the content does not follow
+    the schema, for example when it was cut off by max_tokens. A patch that is not a
+    well-formed unified diff is dropped.
+    """
+    fields = json.loads(content)
+    if not isinstance(fields, dict):
+        raise ValueError("expected an object")
+    locations = []
+    for location in _field(fields, "locations", list):
+        if not isinstance(location, dict):
+            raise ValueError(f"invalid location: {location!r}")
+        locations.append((_field(location, "file", str), _field(location, "line", int)))
+    patch = _field(fields, "patch", str).strip("\n")
+    return Answer(
+        root_cause=_field(fields, "root_cause", str).strip(),
+        locations=locations,
+        explanation=_field(fields, "explanation", str).strip(),
+        patch=patch + "\n" if patch and valid_patch(patch) else "",
+        confidence=min(
+            1.0, max(0.0, float(_field(fields, "confidence", (int, float))))
+        ),
+    )
+
+
+def render(answer: Answer) -> str:
+    """
+    Markdown for humans. The patch is kept in a diff block, where
+    `Explanation.patch()` finds it.
+    """
+    sections = [f"**Root cause:** {answer.root_cause}"]
+    if answer.locations:
+        locations = ", ".join(f"`{file}:{line}`" for file, line in answer.locations)
+        sections.append(f"**Location:** {locations}")
+    if answer.explanation:
+        sections.append(answer.explanation)
+    if answer.patch:
+        sections.append(f"```diff\n{answer.patch}```")
+    sections.append(f"(Confidence: {round(answer.confidence * 100)}%.)")
+    return "\n\n".join(sections)
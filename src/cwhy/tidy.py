@@ -0,0 +1,69 @@
+"""
+Explains clang-tidy findings across a whole tree. Findings are read from saved
+output or `--export-fixes` YAML files, grouped by check and message pattern, and
+each group is explained once from a few representative findings. With
+--apply-fixes, the replacements clang-tidy suggests are applied in bulk.
+"""
+
+import argparse
+import os
+import sys
+from typing import List
+
+import openai
+
+from . import cwhy, engine, frontends
+from .frontends import ErrorCluster, ErrorRecord, clang_tidy
+
+
+def _explain(args: argparse.Namespace, clusters: List[ErrorCluster]) -> None:
+    if args.show_prompt:
+        print("\n\n".join(cwhy.cluster_prompts(args, clusters)))
+        return
+
+    if args.format != "text":
+        # Results files name the command the findings came from.
+        args.command = ["clang-tidy"]
+        try:
+            with engine.Client(args) as client:
+                cwhy.write_results(client, args, "", clusters)
+        except openai.OpenAIError as e:
+            print(str(e).strip(), file=sys.stderr)
+        return
+
+    print("==================================================")
+    print("CWhy")
+    print("==================================================")
+    try:
+        with engine.Client(args) as client:
+            print(cwhy.evaluate_clusters(client, args, clusters))
+    except openai.OpenAIError as e:
+        print(str(e).strip())
+    print("==================================================")
+
+
+def main(args: argparse.Namespace) -> None:
+    records: List[ErrorRecord] = []
+    replacements: List[clang_tidy.Replacement] = []
+    for path in args.results:
+        with open(path, "r", errors="replace") as f:
+            text = f.read()
+        if os.path.splitext(path)[1] in [".yaml", ".yml"]:
+            found, fixes = clang_tidy.parse_fixes(text)
+            records += found
+            replacements += fixes
+        else:
+            records += clang_tidy.parse_output(text)
+
+    # Keep standard output for the results.
+    log = sys.stdout if args.format == "text" else sys.stderr
+    clusters = frontends.cluster_records(records, clang_tidy.ClangTidy(args).key)
+    print(f"{len(records)} findings in {len(clusters)} groups.", file=log)
+    if clusters:
+        # Before applying fixes, so that prompts show the code that was analyzed.
+        _explain(args, clusters)
+
+    if args.apply_fixes and replacements:
+        applied, skipped, files = clang_tidy.apply(replacements)
+        print(f"Applied {applied} fixes to {files} files", end="", file=log)
+        print(f", skipped {skipped} conflicting fixes." if skipped else ".", file=log)
@@ -0,0 +1,152 @@
+"""
+Token counting for prompt budgets.
+
+Encoders are created once per model, and counts are memoized by content hash since
+prompts are built by repeatedly counting overlapping snippets. Models unknown to
+tiktoken, such as Llama served through `OPENAI_BASE_URL`, are estimated from a
+reference encoding scaled by a per-family factor.
+"""
+
+import collections
+import functools
+import hashlib
+import math
+import sys
+import threading
+import time
+from typing import Any, Callable, Optional, Tuple
+
+import llm_utils
+
+# Approximate number of tokens produced by each family relative to cl100k_base,
+# from their vocabularies. Checked in order, the first substring match wins.
+_families = [
+    ("llama3", 1.0),
+    ("llama-3", 1.0),
+    ("codellama", 1.2),
+    ("llama", 1.2),
+    ("mistral", 1.2),
+    ("mixtral", 1.2),
+    ("gemma", 1.05),
+    ("qwen", 1.0),
+    ("deepseek", 1.05),
+    ("phi", 1.2),
+    ("claude", 1.1),
+]
+# For families not listed above, err on the side of overestimating.
+_default_factor = 1.2
+
+_memo_size = 4096
+_memo: "collections.OrderedDict[Tuple[str, bytes], int]" = collections.OrderedDict()
+_memo_lock = threading.Lock()
+
+
+def family_factor(model: str) -> float:
+    name = model.lower().rsplit("/", 1)[-1]
+    for family, factor in _families:
+        if family in name:
+            return factor
+    return _default_factor
+
+
+@functools.lru_cache(maxsize=None)
+def _encoder(model: str) -> Tuple[Optional[Any], float]:
+    """
+    Returns the encoding for the model and the factor to scale its counts by, or no
+    encoding when tiktoken or its data files are not available.
+    """
+    try:
+        import tiktoken
+    except ImportError:
+        return None, 1.0
+    try:
+        try:
+            return tiktoken.encoding_for_model(model), 1.0
+        except KeyError:
+            return tiktoken.get_encoding("cl100k_base"), family_factor(model)
+    except Exception:
+        # The encoding files are downloaded on first use, which fails offline.
+        return None, 1.0
+
+
+def _count(model: str, text: str) -> int:
+    encoding, factor = _encoder(model)
+    if encoding is None:
+        return llm_utils.count_tokens(model, text)
+    count = len(encoding.encode(text, disallowed_special=()))
+    return count if factor == 1.0 else math.ceil(count * factor)
+
+
+def count(model: str, text: str) -> int:
+    key = (model, hashlib.blake2b(text.encode(), digest_size=16).digest())
+    with _memo_lock:
+        if key in _memo:
+            _memo.move_to_end(key)
+            return _memo[key]
+    result = _count(model, text)
+    with _memo_lock:
+        _memo[key] = result
+        if len(_memo) > _memo_size:
+            _memo.popitem(last=False)
+    return result
+
+
+def largest_within(counter: Callable[[int], int], n: int, limit: int) -> int:
+    """
+    Returns the largest k <= n such that counter(k) <= limit, where counter(k) is
+    the token count when taking k items and grows with k. Only O(log n) counts are
+    needed, instead of one per item.
+    """
+    low, high = 0, n
+    while low < high:
+        middle = (low + high + 1) // 2
+        if counter(middle) <= limit:
+            low = middle
+        else:
+            high = middle - 1
+    return low
+
+
+def _benchmark(paths: Any, model: str) -> None:
+    """
+    Measures the cost of building the prompt for each file of compiler output given,
+    with cold and warm memoization.
+    """
+    import argparse
+
+    # Run as __main__, this module is not the one prompts.py uses.
+    from . import prompts, tokens
+
+    args = argparse.Namespace(
+        llm=model,
+        max_error_tokens=1920,
+        max_code_tokens=1920,
+        structured=False,
+        git_context=False,
+        command_context=False,
+    )
+    for path in paths:
+        with open(path, "r") as f:
+            diagnostic = f.read()
+        timings = []
+        for _ in range(2):
+            start = time.perf_counter()
+            prompts.explain_prompt(args, diagnostic)
+            timings.append(time.perf_counter() - start)
+            if len(timings) == 1:
+                encoded = len(tokens._memo)
+        print(
+            f"{path}: {encoded} strings encoded, {timings[0] * 1000:.1f} ms cold, "
+            f"{timings[1] * 1000:.1f} ms memoized"
+        )
+        with tokens._memo_lock:
+            tokens._memo.clear()
+
+
+if __name__ == "__main__":
+    # python3 -m cwhy.tokens [--llm MODEL] DIAGNOSTIC...
+    arguments = sys.argv[1:]
+    llm = "gpt-4o-mini"
+    if arguments[:1] == ["--llm"]:
+        llm, arguments = arguments[1], arguments[2:]
+    _benchmark(arguments, llm)
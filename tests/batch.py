@@ -0,0 +1,229 @@
+"""
+Runs `cwhy batch` end to end against a fake Batch API on localhost: failures are
+recorded with --lazy, submitted as a batch, polled until complete, and collected
+into results files. A second run finds every explanation in the cache.
+
+    python3 -m tests.batch
+"""
+
+import email.parser
+import http.server
+import json
+import os
+import subprocess
+import sys
+import tempfile
+import threading
+from typing import Any, Dict, List, Optional
+
+# Polls answered "in_progress" before the batch completes.
+IN_PROGRESS_POLLS = 1
+
+
+def answer(request: Dict[str, Any]) -> Dict[str, Any]:
+    """
+    A line of the output file, explaining the request by its custom_id.
+    """
+    body = {
+        "id": f"chatcmpl-{request['custom_id']}",
+        "object": "chat.completion",
+        "created": 0,
+        "model": request["body"]["model"],
+        "choices": [
+            {
+                "index": 0,
+                "message": {
+                    "role": "assistant",
+                    "content": f"Explanation of {request['custom_id']}.",
+                },
+                "finish_reason": "stop",
+            }
+        ],
+        "usage": {"prompt_tokens": 100, "completion_tokens": 10, "total_tokens": 110},
+    }
+    return {
+        "id": f"response-{request['custom_id']}",
+        "custom_id": request["custom_id"],
+        "response": {"status_code": 200, "request_id": "request", "body": body},
+        "error": None,
+    }
+
+
+class FakeBatchAPI(http.server.ThreadingHTTPServer):
+    """
+    The parts of the Files and Batches endpoints that `cwhy batch` uses.
+    """
+
+    def __init__(self) -> None:
+        super().__init__(("127.0.0.1", 0), FakeBatchHandler)
+        self.files: Dict[str, bytes] = {}
+        self.batches: Dict[str, Dict[str, Any]] = {}
+        self.requests: List[Dict[str, Any]] = []
+        self.polls = 0
+
+    @property
+    def url(self) -> str:
+        return f"http://127.0.0.1:{self.server_address[1]}/v1"
+
+    def add_file(self, content: bytes) -> Dict[str, Any]:
+        file_id = f"file-{len(self.files) + 1}"
+        self.files[file_id] = content
+        return {
+            "id": file_id,
+            "object": "file",
+            "bytes": len(content),
+            "created_at": 0,
+            "filename": f"{file_id}.jsonl",
+            "purpose": "batch",
+            "status": "processed",
+        }
+
+    def create_batch(self, body: Dict[str, Any]) -> Dict[str, Any]:
+        lines = self.files[body["input_file_id"]].decode().splitlines()
+        requests = [json.loads(line) for line in lines if line.strip()]
+        self.requests.extend(requests)
+        batch = {
+            "id": f"batch-{len(self.batches) + 1}",
+            "object": "batch",
+            "endpoint": body["endpoint"],
+            "input_file_id": body["input_file_id"],
+            "completion_window": body["completion_window"],
+            "created_at": 0,
+            "status": "validating",
+            "request_counts": {"total": len(requests), "completed": 0, "failed": 0},
+        }
+        self.batches[batch["id"]] = batch
+        return batch
+
+    def poll_batch(self, batch_id: str) -> Optional[Dict[str, Any]]:
+        batch = self.batches.get(batch_id)
+        if batch is None:
+            return None
+        self.polls += 1
+        if self.polls <= IN_PROGRESS_POLLS:
+            batch["status"] = "in_progress"
+        elif batch["status"] != "completed":
+            lines = self.files[batch["input_file_id"]].decode().splitlines()
+            answers = [answer(json.loads(line)) for line in lines if line.strip()]
+            output = "".join(json.dumps(a) + "\n" for a in answers)
+            batch["output_file_id"] = self.add_file(output.encode())["id"]
+            batch["status"] = "completed"
+            batch["request_counts"]["completed"] = len(answers)
+        return batch
+
+
+class FakeBatchHandler(http.server.BaseHTTPRequestHandler):
+    server: FakeBatchAPI
+
+    def log_message(self, format: str, *args: Any) -> None:
+        pass
+
+    def reply(self, status: int, body: bytes, content_type: str) -> None:
+        self.send_response(status)
+        self.send_header("Content-Type", content_type)
+        self.send_header("Content-Length", str(len(body)))
+        self.end_headers()
+        self.wfile.write(body)
+
+    def reply_json(self, value: Optional[Dict[str, Any]]) -> None:
+        if value is None:
+            error = {"error": {"message": "not found", "type": "invalid_request"}}
+            self.reply(404, json.dumps(error).encode(), "application/json")
+        else:
+            self.reply(200, json.dumps(value).encode(), "application/json")
+
+    def do_POST(self) -> None:
+        body = self.rfile.read(int(self.headers.get("Content-Length") or 0))
+        if self.path == "/v1/files":
+            # Multipart form data, with the JSON lines as the `file` part.
+            header = f"Content-Type: {self.headers['Content-Type']}\r\n\r\n"
+            message = email.parser.BytesParser().parsebytes(header.encode() + body)
+            for part in message.walk():
+                if part.get_param("name", header="content-disposition") == "file":
+                    content = part.get_payload(decode=True)
+                    assert isinstance(content, bytes)
+                    self.reply_json(self.server.add_file(content))
+                    return
+            self.reply_json(None)
+        elif self.path == "/v1/batches":
+            self.reply_json(self.server.create_batch(json.loads(body)))
+        else:
+            self.reply_json(None)
+
+    def do_GET(self) -> None:
+        parts = self.path.strip("/").split("/")
+        if parts[:2] == ["v1", "batches"] and len(parts) == 3:
+            self.reply_json(self.server.poll_batch(parts[2]))
+        elif parts[:2] == ["v1", "files"] and parts[3:] == ["content"]:
+            content = self.server.files.get(parts[2])
+            if content is None:
+                self.reply_json(None)
+            else:
+                self.reply(200, content, "application/octet-stream")
+        else:
+            self.reply_json(None)
+
+
+def cwhy(arguments: List[str], directory: str, environment: Dict[str, str]) -> None:
+    subprocess.run(
+        [sys.executable, "-m", "cwhy", *arguments],
+        cwd=directory,
+        env=environment,
+        stdout=subprocess.DEVNULL,
+        stderr=subprocess.DEVNULL,
+    )
+
+
+def main() -> None:
+    server = FakeBatchAPI()
+    threading.Thread(target=server.serve_forever, daemon=True).start()
+
+    with tempfile.TemporaryDirectory() as directory:
+        environment = {
+            **os.environ,
+            "OPENAI_BASE_URL": server.url,
+            "OPENAI_API_KEY": "test",
+            "CWHY_CACHE_DIR": os.path.join(directory, "cache"),
+        }
+        # Two failures with different root causes.
+        for statement in ["import cwhy_missing_module", "1 / 0"]:
+            cwhy(
+                ["--lazy", "--output", "failures.jsonl", "---", sys.executable]
+                + ["-c", statement],
+                directory,
+                environment,
+            )
+        with open(os.path.join(directory, "failures.jsonl")) as f:
+            failures = [json.loads(line) for line in f if line.strip()]
+        assert len(failures) == 2, failures
+
+        output = os.path.join(directory, "results")
+        cwhy(["batch", "--output", output, "failures.jsonl"], directory, environment)
+        assert len(server.batches) == 1, server.batches
+        assert len(server.requests) == 2, server.requests
+        assert server.polls == IN_PROGRESS_POLLS + 1, server.polls
+        assert not os.path.exists(os.path.join(output, "batch.json"))
+
+        explained = {}
+        for name in os.listdir(output):
+            with open(os.path.join(output, name)) as f:
+                for line in f:
+                    entry = json.loads(line)
+                    explained[entry["fingerprint"]] = entry
+        assert sorted(explained) == sorted(r["custom_id"] for r in server.requests)
+        for key, entry in explained.items():
+            assert entry["explanation"] == f"Explanation of {key}.", entry
+            assert entry["promptTokens"] == 100, entry
+            assert "diagnostic" not in entry, entry
+
+        # Explanations were cached, nothing is submitted again.
+        cwhy(["batch", "--output", output, "failures.jsonl"], directory, environment)
+        assert len(server.batches) == 1, server.batches
+        assert len(os.listdir(output)) == len(explained)
+
+    server.shutdown()
+    print("Batch test passed.")
+
+
+if __name__ == "__main__":
+    main()
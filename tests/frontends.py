@@ -0,0 +1,509 @@
+"""
+Feeds output captured from each tool to its front end, and checks the records and
+clusters parsed from it.
+
+    python3 -m tests.frontends
+"""
+
+import argparse
+import os
+import shutil
+import tempfile
+from typing import Callable, List, Optional, Tuple, Type, TypeVar
+
+from cwhy import frontends
+from cwhy.frontends import clang_tidy as clang_tidy_module
+
+ROOT = os.path.dirname(os.path.abspath(__file__))
+
+F = TypeVar("F", bound=frontends.FrontEnd)
+
+
+def captured(name: str) -> str:
+    with open(os.path.join(ROOT, "captured", name), "r") as f:
+        return f.read()
+
+
+def frontend(command: List[str], kind: Type[F]) -> F:
+    """
+    The front end detected for the command, checked to be of the kind expected.
+    """
+    args = argparse.Namespace(command=command, subcommand="explain")
+    result = frontends.detect(args)
+    assert isinstance(result, kind), (command, result)
+    return result
+
+
+def typescript() -> None:
+    tsc = frontend(["npx", "tsc", "--noEmit"], frontends.TypeScript)
+    records = tsc.parse(captured("tsc.out"), "")
+    assert len(records) == 8, records
+    assert records[6].details == [
+        "  Types of property 'id' are incompatible.",
+        "    Type 'string' is not assignable to type 'number'.",
+    ], records[6]
+    assert records[7].file is None and records[7].code == "TS5083", records[7]
+
+    clusters = tsc.clusters(captured("tsc.out"), "")
+    sizes = {cluster.key: len(cluster.records) for cluster in clusters}
+    # Assigning different types to the same target are different mistakes.
+    assert sizes["TS2322 'string' 'number'"] == 2, sizes
+    assert sizes["TS2322 'undefined' 'number'"] == 1, sizes
+    assert sizes["TS2339 'fullName' 'User'"] == 2, sizes
+    assert len(clusters) == 6, sizes
+
+
+def maven() -> None:
+    mvn = frontend(["./mvnw", "compile"], frontends.JVM)
+    assert mvn.prepare(["./mvnw", "compile"])[-1] == "--batch-mode"
+    records = mvn.parse(captured("mvn.out"), "")
+    # The errors repeated by the summary at the end are dropped.
+    assert len(records) == 3, records
+    assert [r.group for r in records] == ["shop-core", "shop-core", "shop-web"]
+    assert (records[1].line, records[1].column) == (22, 16), records[1]
+    assert records[2].details[0].strip() == "symbol:   method render()"
+
+    clusters = mvn.clusters(captured("mvn.out"), "")
+    assert [len(cluster.records) for cluster in clusters] == [2, 1], clusters
+    assert clusters[1].key.startswith("[shop-web] cannot find symbol"), clusters[1]
+
+
+def gradle() -> None:
+    gradlew = frontend(["./gradlew", "build", "--continue"], frontends.JVM)
+    records = gradlew.parse(captured("gradle.out"), "")
+    assert len(records) == 2, records
+    assert (records[0].group, records[0].line) == ("core", 14), records[0]
+    assert "^" not in [d.strip() for d in records[0].details], records[0]
+    assert (records[1].group, records[1].column) == ("web", 5), records[1]
+    assert records[1].file == "/work/shop/web/src/main/kotlin/com/example/Page.kt"
+
+
+def latex() -> None:
+    with tempfile.TemporaryDirectory() as directory:
+        command = ["env", "TEXINPUTS=.:", "pdflatex", "-output-directory"]
+        command += [directory, "paper.tex"]
+        pdflatex = frontend(command, frontends.LaTeX)
+        log = os.path.join(directory, "paper.log")
+        assert pdflatex.log_path() == log, pdflatex.log_path()
+        assert "-interaction=nonstopmode" in pdflatex.prepare(command)
+
+        # Left by an earlier build, the log is not read.
+        shutil.copy(os.path.join(ROOT, "captured", "paper.log"), log)
+        pdflatex.prepare(command)
+        assert pdflatex.parse("", "") == []
+
+        os.utime(log, ns=(0, os.stat(log).st_mtime_ns + 1))
+        records = pdflatex.parse("", "")
+
+    assert len(records) == 4, records
+    # The opened files are followed across the lines TeX wrapped.
+    assert (records[0].file, records[0].line) == ("./chapters/intro.tex", 12)
+    assert records[1].code == "undefined reference", records[1]
+    assert (records[2].file, records[2].line) == ("./paper.tex", 31), records[2]
+    assert records[2].message == "Missing $ inserted.", records[2]
+    assert records[3].message == "Citation `knuth84' undefined", records[3]
+
+
+def go() -> None:
+    build = frontend(["go", "build", "./testme.go"], frontends.Go)
+    records = build.parse(captured("go-build.json"), "")
+    assert len(records) == 2, records
+    assert (records[0].file, records[0].line, records[0].column) == (
+        "./testme.go",
+        6,
+        30,
+    )
+    assert records[1].group == "command-line-arguments", records[1]
+    # Shown as `go build` prints it without -json.
+    build.json_requested = True
+    with open(os.path.join(ROOT, "go", "testme.go.out"), "r") as f:
+        plain = f.read().splitlines()
+    shown = build.display(captured("go-build.json"), "")[0].splitlines()
+    assert shown == plain[: len(shown)], shown
+
+    test = frontend(["go", "test", "./..."], frontends.Go)
+    records = test.parse(captured("go-test.json"), "")
+    assert len(records) == 1, records
+    assert (records[0].code, records[0].file, records[0].line) == (
+        "TestTotal",
+        "cart_test.go",
+        7,
+    )
+    assert records[0].message == "Total() = 5, want 6", records[0]
+    test.json_requested = True
+    output = test.display(captured("go-test.json"), "")[0]
+    assert "--- FAIL: TestTotal" in output and "TestEmpty" not in output, output
+
+    # Added by cwhy, -json must not turn findings into a success.
+    vet = frontend(["go", "vet", "./..."], frontends.Go)
+    command = vet.prepare(["go", "vet", "./..."])
+    assert command == ["go", "vet", "-json", "./..."], command
+    vet.args.command = command
+    records = vet.parse("", captured("go-vet.json"))
+    assert len(records) == 1, records
+    assert (records[0].code, records[0].line, records[0].column) == ("printf", 14, 9)
+    assert records[0].group == "example.com/shop/shop", records[0]
+    assert vet.returncode(0, "", captured("go-vet.json")) == 1
+    assert not vet.has_findings("", captured("go-vet.json"))
+
+    # Passed by the user, the status is theirs.
+    vet = frontend(["go", "vet", "-json", "./..."], frontends.Go)
+    assert vet.prepare(vet.args.command) == vet.args.command
+    assert vet.returncode(0, "", captured("go-vet.json")) == 0
+    assert vet.has_findings("", captured("go-vet.json"))
+
+
+def dotnet() -> None:
+    build = frontend(["dotnet", "build"], frontends.DotNet)
+    records = build.parse(captured("dotnet-build.out"), "")
+    # Once each, although reported per target and again in the summary.
+    assert len(records) == 3, records
+    assert (records[1].line, records[1].column) == (13, 44), records[1]
+    assert (records[1].end_line, records[1].end_column) == (13, 45), records[1]
+    assert [r.group for r in records] == ["app", "app", "lib"], records
+    assert records[2].file is None and records[2].code == "CS5001", records[2]
+
+    # The errors-only log is read instead of the console.
+    command = build.prepare(["dotnet", "test", "--", "--filter", "Cart"])
+    assert command[2].startswith("-flp9:LogFile=") and command[3] == "--", command
+    build.args.command = command
+    log = build.log_path(command)
+    assert log and log == build.temporary, command
+    shutil.copy(os.path.join(ROOT, "captured", "dotnet-errors.log"), log)
+    assert build.parse("", "") == records
+    build.cleanup()
+    assert not os.path.exists(log)
+
+    # The program would be given the switch.
+    run = frontend(["dotnet", "run", "--project", "app"], frontends.DotNet)
+    assert run.prepare(run.args.command) == run.args.command
+
+
+def python() -> None:
+    script = frontend(["python3", "app.py"], frontends.Python)
+    records = script.parse("", captured("traceback.out"))
+    # The three tracebacks of the chain are a single error.
+    assert len(records) == 1, records
+    record = records[0]
+    assert record.message == "NameError: name 'undefined_name' is not defined"
+    assert (record.file, record.line) == ("/work/shop/app.py", 16), record
+    assert "FileNotFoundError" in record.details[2], record.details
+    assert sum(line.startswith(("The above", "During")) for line in record.details) == 2
+    assert not any("^^^" in line for line in record.details), record.details
+
+    pytest = frontend(["python3", "-m", "pytest"], frontends.Python)
+    # With a blank line, and the last report cut short by Ctrl-C.
+    records = pytest.parse_report_log(captured("pytest-report.jsonl"))
+    assert [r.code for r in records] == [
+        "test_cart.py::test_total[1]",
+        "test_cart.py::test_total[2]",
+        "test_cart.py::test_total[3]",
+        "test_cart.py::test_parse",
+    ], records
+    assert (records[0].file, records[0].line) == ("/work/shop/test_cart.py", 16)
+    assert records[0].message == "AssertionError: assert 1 == (1 + 1)", records[0]
+    clusters = frontends.cluster_records(records, pytest.key)
+    # Parametrized tests failing the same way are explained once.
+    assert [len(cluster.records) for cluster in clusters] == [3, 1], clusters
+
+    # Without the report-log plugin.
+    records = pytest.parse_pytest(captured("pytest.out"))
+    assert [r.code for r in records] == [
+        "test_total[1]",
+        "test_total[2]",
+        "test_total[3]",
+        "test_parse",
+    ], records
+    assert (records[0].file, records[0].line) == ("test_cart.py", 16), records[0]
+    assert records[3].message.startswith("json.decoder.JSONDecodeError: Expecting")
+
+
+class BitWriter:
+    """
+    The LLVM bitstream encoding, to write .dia files laid out as clang and swiftc
+    write them.
+    """
+
+    def __init__(self) -> None:
+        self.value = 0
+        self.position = 0
+
+    def write(self, value: int, width: int) -> None:
+        self.value |= value << self.position
+        self.position += width
+
+    def write_vbr(self, value: int, width: int) -> None:
+        high = 1 << (width - 1)
+        while value >= high:
+            self.write(value & (high - 1) | high, width)
+            value >>= width - 1
+        self.write(value, width)
+
+    def align32(self) -> None:
+        self.position = (self.position + 31) & ~31
+
+    def enter(self, outer: int, block: int, width: int) -> int:
+        """
+        Enters a block from one whose abbreviations are outer bits wide.
+        """
+        self.write(1, outer)
+        self.write_vbr(block, 8)
+        self.write_vbr(width, 4)
+        self.align32()
+        # The block length in words, which the reader skips.
+        self.write(0, 32)
+        return width
+
+    def end(self, width: int) -> None:
+        self.write(0, width)
+        self.align32()
+
+    def define(self, operands: List[Tuple[Optional[int], int]]) -> None:
+        """
+        Operands are literals, (value, 0), or fixed-width fields, (None, width).
+        A blob is always last.
+        """
+        self.write(2, 2)
+        self.write_vbr(len(operands) + 1, 5)
+        for literal, width in operands:
+            if literal is not None:
+                self.write(1, 1)
+                self.write_vbr(literal, 8)
+            else:
+                self.write(0, 1)
+                self.write(1, 3)
+                self.write_vbr(width, 5)
+        self.write(0, 1)
+        self.write(5, 3)
+
+    def record(self, abbrev: int, fields: List[Tuple[int, int]], blob: bytes) -> None:
+        self.write(abbrev, 4)
+        for value, width in fields:
+            self.write(value, width)
+        self.write_vbr(len(blob), 6)
+        self.align32()
+        for byte in blob:
+            self.write(byte, 8)
+        self.align32()
+
+    def bytes(self) -> bytes:
+        return self.value.to_bytes((self.position + 7) // 8, "little")
+
+
+DIAG_BLOCK = 9
+# (severity, file, line, column, message, notes)
+_Diagnostic = Tuple[int, str, int, int, str, list]
+
+
+def dia(diagnostics: List[_Diagnostic]) -> bytes:
+    """
+    A serialized diagnostics file, with the abbreviations clang registers in the
+    BLOCKINFO block and a nested block for each note.
+    """
+    writer = BitWriter()
+    writer.write(int.from_bytes(b"DIAG", "little"), 32)
+    writer.enter(2, 0, 2)
+    # SETBID for the diagnostics block, then its abbreviations: RECORD_DIAG is
+    # severity, location (file, line, column, offset), category, flag and text,
+    # RECORD_FILENAME is file ID, size, modification time and name.
+    writer.write(3, 2)
+    writer.write_vbr(1, 6)
+    writer.write_vbr(1, 6)
+    writer.write_vbr(DIAG_BLOCK, 6)
+    writer.define(
+        [(2, 0), (None, 3), (None, 10), (None, 32), (None, 32)]
+        + [(None, 32), (None, 10), (None, 10), (None, 16)]
+    )
+    writer.define([(6, 0), (None, 10), (None, 32), (None, 32), (None, 16)])
+    writer.end(2)
+    # The META block, with the format version as an unabbreviated record.
+    writer.enter(2, 8, 3)
+    writer.write(3, 3)
+    for value in [1, 1, 2]:
+        writer.write_vbr(value, 6)
+    writer.end(3)
+
+    files: List[str] = []
+
+    def write(diagnostic: _Diagnostic, outer: int) -> None:
+        severity, file, line, column, message, notes = diagnostic
+        width = writer.enter(outer, DIAG_BLOCK, 4)
+        if file not in files:
+            files.append(file)
+            name = file.encode()
+            writer.record(
+                5, [(len(files), 10), (0, 32), (0, 32), (len(name), 16)], name
+            )
+        text = message.encode()
+        fields = [(severity, 3), (files.index(file) + 1, 10), (line, 32), (column, 32)]
+        fields += [(0, 32), (0, 10), (0, 10), (len(text), 16)]
+        writer.record(4, fields, text)
+        for note in notes:
+            write(note, width)
+        writer.end(width)
+
+    for diagnostic in diagnostics:
+        write(diagnostic, 2)
+    return writer.bytes()
+
+
+def swift() -> None:
+    with tempfile.TemporaryDirectory() as directory:
+        path = os.path.join(directory, "testme.dia")
+        command = ["swiftc", "testme.swift", "-serialize-diagnostics-path", path]
+        swiftc = frontend(command, frontends.Swift)
+        # Given by the user, at the end of the command.
+        assert swiftc.prepare(command) == command
+        note: _Diagnostic = (
+            1,
+            "testme.swift",
+            2,
+            5,
+            "did you mean 'myDictionary'?",
+            [],
+        )
+        with open(path, "wb") as f:
+            f.write(
+                dia(
+                    [
+                        (2, "testme.swift", 1, 5, "variable was never mutated", []),
+                        (
+                            3,
+                            "testme.swift",
+                            4,
+                            21,
+                            "cannot find 'myDictionar' in scope",
+                            [note],
+                        ),
+                    ]
+                )
+            )
+        records = swiftc.parse("", "")
+        swiftc.cleanup()
+        assert os.path.exists(path)
+
+    # Warnings are left out, notes follow their error.
+    assert len(records) == 1, records
+    assert (records[0].file, records[0].line, records[0].column) == (
+        "testme.swift",
+        4,
+        21,
+    )
+    assert records[0].message == "cannot find 'myDictionar' in scope", records[0]
+    assert records[0].details == [
+        "testme.swift:2:5: note: did you mean 'myDictionary'?"
+    ], records[0]
+
+    # Added by cwhy for a single input, and removed again.
+    swiftc = frontend(["swiftc", "testme.swift"], frontends.Swift)
+    command = swiftc.prepare(swiftc.args.command)
+    assert command[-4:-1] == ["-Xfrontend", "-serialize-diagnostics-path", "-Xfrontend"]
+    assert swiftc.temporary == command[-1]
+    swiftc.cleanup()
+    assert not os.path.exists(command[-1])
+
+
+def haskell() -> None:
+    ghc = frontend(["ghc", "testme.hs"], frontends.Haskell)
+    records = ghc.parse("", captured("ghc.json"))
+    assert [(r.code, r.line, r.column) for r in records] == [
+        ("GHC-83865", 6, 11),
+        ("GHC-39999", 9, 8),
+    ], records
+    assert (records[0].end_line, records[0].end_column) == (6, 18), records[0]
+    assert records[0].message.startswith("Couldn't match type"), records[0]
+    # The enclosing definitions and bindings only repeat the code.
+    assert not any("equation" in line for line in records[0].details), records[0]
+    assert not any("Relevant" in line for line in records[0].details), records[0]
+
+    # Shown as GHC prints it without -fdiagnostics-as-json.
+    ghc.json_requested = True
+    shown = ghc.display("", captured("ghc.json"))[1].splitlines()
+    assert shown[0] == "[1 of 2] Compiling Main             ( testme.hs, testme.o )"
+    assert "testme.hs:6:11: error: [GHC-83865]" in shown, shown
+    assert "    • Couldn't match type ‘[Char]’ with ‘Int’" in shown, shown
+
+
+_shape = """#include "shape.hpp"
+
+int Shape::area() {
+    int area;
+    return area;
+}
+
+int* Shape::name() {
+    return NULL;
+}
+"""
+
+
+def clang_tidy() -> None:
+    tidy = frontend(["run-clang-tidy", "-p", "build"], frontends.ClangTidy)
+    records = tidy.parse(captured("clang-tidy.out"), "")
+    # The header's finding is reported by both translation units including it.
+    assert len(records) == 5, records
+    assert [r.code for r in records] == [
+        "cppcoreguidelines-init-variables",
+        "modernize-use-nullptr",
+        "cppcoreguidelines-special-member-functions",
+        "cppcoreguidelines-init-variables",
+        "clang-diagnostic-error",
+    ], records
+    assert records[2].details == ["include/shape.hpp:9:5: note: declared here"]
+    assert tidy.has_findings(captured("clang-tidy.out"), "")
+    assert not tidy.has_findings("Suppressed 3 warnings (3 in non-user code).", "")
+
+    clusters = tidy.clusters(captured("clang-tidy.out"), "")
+    sizes = {cluster.key: len(cluster.records) for cluster in clusters}
+    key = "cppcoreguidelines-init-variables: variable '…' is not initialized"
+    assert sizes[key] == 2, sizes
+    assert len(clusters) == 4, sizes
+
+    with tempfile.TemporaryDirectory() as directory:
+        for name in ["build", "src"]:
+            os.makedirs(os.path.join(directory, name))
+        source = os.path.join(directory, "src", "shape.cpp")
+        with open(source, "w") as f:
+            f.write(_shape)
+        text = captured("clang-tidy-fixes.yaml").replace("/work", directory)
+        records, replacements = clang_tidy_module.parse_fixes(text)
+        # Paths are relative to the build directory.
+        build = os.path.join(directory, "build")
+        assert {r.file for r in records} == {os.path.join(build, "../src/shape.cpp")}
+        assert [(r.code, r.line, r.column) for r in records] == [
+            ("cppcoreguidelines-init-variables", 4, 9),
+            ("modernize-use-nullptr", 9, 12),
+            ("readability-braces-around-statements", 9, 12),
+        ], records
+        # The finding repeated by the second translation unit is kept once.
+        assert len(replacements) == 3, replacements
+
+        # Fixes at the same offset conflict, and the later one is skipped.
+        assert clang_tidy_module.apply(replacements) == (2, 1, 1)
+        with open(source, "r") as f:
+            fixed = f.read()
+    assert "    int area = 0;\n" in fixed, fixed
+
+
+TESTS: List[Callable[[], None]] = [
+    typescript,
+    maven,
+    gradle,
+    latex,
+    go,
+    dotnet,
+    python,
+    swift,
+    haskell,
+    clang_tidy,
+]
+
+
+def main() -> None:
+    for test in TESTS:
+        test()
+        print(f"{test.__name__} passed.")
+
+
+if __name__ == "__main__":
+    main()
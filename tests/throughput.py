@@ -0,0 +1,157 @@
+"""
+Measures how many explanations per second --pack-tokens gets out of a rate-limited
+API. A local server stands in for the API: it starts at most --rpm requests per
+minute, answers each after --latency seconds, and answers bundles with one
+explanation per error.
+
+    python3 -m tests.throughput [--errors 40] [--rpm 120] [--latency 0.5]
+"""
+
+import argparse
+import http.server
+import json
+import os
+import re
+import tempfile
+import threading
+import time
+from typing import Any, Dict, List
+
+from cwhy import cwhy, endpoints, engine, packing
+
+_error_heading = re.compile(r"^## Error (\d+)$", re.MULTILINE)
+
+
+class FakeChatAPI(http.server.ThreadingHTTPServer):
+    """
+    Chat completions, started one at a time every 60 / rpm seconds, the way a
+    requests-per-minute limit spreads them out when clients back off.
+    """
+
+    def __init__(self, rpm: int, latency: float):
+        super().__init__(("127.0.0.1", 0), FakeChatHandler)
+        self.interval = 60 / rpm
+        self.latency = latency
+        self.lock = threading.Lock()
+        self.next_start = 0.0
+        self.requests = 0
+
+    @property
+    def url(self) -> str:
+        return f"http://127.0.0.1:{self.server_address[1]}/v1"
+
+    def wait_for_slot(self) -> None:
+        with self.lock:
+            now = time.monotonic()
+            start = max(now, self.next_start)
+            self.next_start = start + self.interval
+            self.requests += 1
+        time.sleep(start - now + self.latency)
+
+    def complete(self, request: Dict[str, Any]) -> Dict[str, Any]:
+        self.wait_for_slot()
+        prompt = request["messages"][-1]["content"]
+        response_format = request.get("response_format") or {}
+        if response_format == packing.RESPONSE_FORMAT:
+            answers = [
+                {"id": number, "explanation": f"Explanation of error {number}."}
+                for number in _error_heading.findall(prompt)
+            ]
+            content = json.dumps({"answers": answers})
+        else:
+            content = "Explanation of the error."
+        return {
+            "id": f"chatcmpl-{self.requests}",
+            "object": "chat.completion",
+            "created": 0,
+            "model": request["model"],
+            "choices": [
+                {
+                    "index": 0,
+                    "message": {"role": "assistant", "content": content},
+                    "finish_reason": "stop",
+                }
+            ],
+            "usage": {
+                "prompt_tokens": len(prompt) // 4,
+                "completion_tokens": len(content) // 4,
+                "total_tokens": (len(prompt) + len(content)) // 4,
+            },
+        }
+
+
+class FakeChatHandler(http.server.BaseHTTPRequestHandler):
+    server: FakeChatAPI
+
+    def log_message(self, format: str, *args: Any) -> None:
+        pass
+
+    def do_POST(self) -> None:
+        body = self.rfile.read(int(self.headers.get("Content-Length") or 0))
+        if self.path != "/v1/chat/completions":
+            self.send_error(404)
+            return
+        reply = json.dumps(self.server.complete(json.loads(body))).encode()
+        self.send_response(200)
+        self.send_header("Content-Type", "application/json")
+        self.send_header("Content-Length", str(len(reply)))
+        self.end_headers()
+        self.wfile.write(reply)
+
+
+def error_prompts(n: int) -> List[str]:
+    """
+    Small, unrelated errors, as a build with many one-line mistakes produces.
+    """
+    return [
+        f"This is my error:\ntest.cpp:{i + 1}:1: error: redefinition of "
+        f"'int f{i}()'\n\nWhat's the problem?"
+        for i in range(n)
+    ]
+
+
+def main(options: argparse.Namespace) -> None:
+    server = FakeChatAPI(options.rpm, options.latency)
+    threading.Thread(target=server.serve_forever, daemon=True).start()
+    endpoint = endpoints.Endpoint(server.url, "test")
+    requests = error_prompts(options.errors)
+
+    print(
+        f"{options.errors} errors, {options.rpm} requests per minute, "
+        f"{options.latency} s per response"
+    )
+    with tempfile.TemporaryDirectory() as directory:
+        # Bundled answers are cached, keep them out of the user's cache.
+        os.environ["CWHY_CACHE_DIR"] = directory
+        for pack_tokens in [0, *options.pack_tokens]:
+            args = argparse.Namespace(
+                llm=options.llm,
+                timeout=options.timeout,
+                jobs=options.jobs,
+                pack_tokens=pack_tokens,
+            )
+            server.requests = 0
+            start = time.monotonic()
+            with engine.Client(args, endpoint) as client:
+                explained = dict(cwhy.explain_concurrently(client, args, requests))
+            elapsed = time.monotonic() - start
+            assert len(explained) == options.errors, explained
+            print(
+                f"--pack-tokens {pack_tokens:>5}: {server.requests:>3} requests, "
+                f"{elapsed:5.1f} s, {len(explained) / elapsed:5.2f} explanations/s"
+            )
+    server.shutdown()
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--errors", type=int, default=40)
+    parser.add_argument("--rpm", type=int, default=120)
+    parser.add_argument("--latency", type=float, default=0.5)
+    parser.add_argument("--jobs", type=int, default=8)
+    parser.add_argument("--timeout", type=int, default=60)
+    parser.add_argument("--llm", default="gpt-4o-mini")
+    parser.add_argument(
+        "--pack-tokens", type=int, nargs="+", default=[2000], dest="pack_tokens"
+    )
+    main(parser.parse_args())